@@ -22,6 +22,8 @@
 
 #ifdef _WIN32
 #include <windows.h>
+#else
+#include <unistd.h>
 #endif
 
 #ifdef USE_QT_LOOP
@@ -104,10 +106,48 @@ std::vector<std::string> exposedFunctions = {
 	"startReplayBuffer",   "stopReplayBuffer", "saveReplayBuffer",
 	"startVirtualcam",     "stopVirtualcam",   "getScenes",
 	"setCurrentScene",     "getTransitions",   "getCurrentTransition",
-	"setCurrentTransition"};
+	"setCurrentTransition", "ping"};
+
+void BrowserApp::OnBrowserCreated(CefRefPtr<CefBrowser> browser,
+				  CefRefPtr<CefDictionaryValue> extra_info)
+{
+	if (extra_info && extra_info->HasKey("css"))
+		browserCSS[browser->GetIdentifier()] =
+			extra_info->GetString("css");
+}
+
+void BrowserApp::OnBrowserDestroyed(CefRefPtr<CefBrowser> browser)
+{
+	browserCSS.erase(browser->GetIdentifier());
+}
+
+/* Runs before any page script.  The style element goes in as soon as the
+ * parser creates the root element, then is moved to the end of <head> on
+ * DOMContentLoaded so it still overrides the page's own stylesheets. */
+void BrowserApp::InjectCSS(CefRefPtr<CefV8Context> context,
+			   const std::string &css)
+{
+	std::string script;
+	script += "(function() {";
+	script += "const obsCSS = document.createElement('style');";
+	script += "obsCSS.textContent = decodeURIComponent(\"" + css + "\");";
+	script += "const append = () => (document.head || "
+		  "document.documentElement).appendChild(obsCSS);";
+	script += "document.addEventListener('DOMContentLoaded', append);";
+	script += "if (document.documentElement) { append(); return; }";
+	script += "const observer = new MutationObserver(() => {";
+	script += "if (!document.documentElement) return;";
+	script += "observer.disconnect(); append(); });";
+	script += "observer.observe(document, {childList: true});";
+	script += "})();";
+
+	CefRefPtr<CefV8Value> retval;
+	CefRefPtr<CefV8Exception> exception;
+	context->Eval(script, "", 0, retval, exception);
+}
 
 void BrowserApp::OnContextCreated(CefRefPtr<CefBrowser> browser,
-				  CefRefPtr<CefFrame>,
+				  CefRefPtr<CefFrame> frame,
 				  CefRefPtr<CefV8Context> context)
 {
 	CefRefPtr<CefV8Value> globalObj = context->GetGlobal();
@@ -134,6 +174,36 @@ void BrowserApp::OnContextCreated(CefRefPtr<CefBrowser> browser,
 		SetDocumentVisibility(browser, browserVis[id]);
 	}
 #endif
+
+	if (frame->IsMain()) {
+		auto css = browserCSS.find(browser->GetIdentifier());
+		if (css != browserCSS.end())
+			InjectCSS(context, css->second);
+
+		/* lets the source account this process' memory and CPU */
+		CefRefPtr<CefProcessMessage> msg =
+			CefProcessMessage::Create("RendererInfo");
+#ifdef _WIN32
+		msg->GetArgumentList()->SetInt(0, (int)GetCurrentProcessId());
+#else
+		msg->GetArgumentList()->SetInt(0, (int)getpid());
+#endif
+		SendBrowserProcessMessage(browser, PID_BROWSER, msg);
+	}
+}
+
+void BrowserApp::OnContextReleased(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>,
+				   CefRefPtr<CefV8Context> context)
+{
+	/* a ping whose page is gone never gets its answer delivered */
+	for (auto it = pingStart.begin(); it != pingStart.end();) {
+		if (it->second.context->IsSame(context)) {
+			callbackMap.erase(it->first);
+			it = pingStart.erase(it);
+		} else {
+			++it;
+		}
+	}
 }
 
 void BrowserApp::ExecuteJSFunction(CefRefPtr<CefBrowser> browser,
@@ -261,6 +331,14 @@ bool BrowserApp::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
 		SetDocumentVisibility(browser, args->GetBool(0));
 #endif
 
+	} else if (message->GetName() == "Ping") {
+		/* answered right away, the round trip measures the IPC and
+		 * the browser process UI thread */
+		CefRefPtr<CefProcessMessage> msg =
+			CefProcessMessage::Create("Pong");
+		msg->GetArgumentList()->SetInt(0, args->GetInt(0));
+		SendBrowserProcessMessage(browser, PID_BROWSER, msg);
+
 	} else if (message->GetName() == "Active") {
 		CefV8ValueList arguments;
 		arguments.push_back(CefV8Value::CreateBool(args->GetBool(0)));
@@ -320,18 +398,29 @@ bool BrowserApp::OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
 		int callbackID = arguments->GetInt(0);
 		CefString jsonString = arguments->GetString(1);
 
-		std::string script;
-		script += "JSON.parse('";
-		script += arguments->GetString(1).ToString();
-		script += "');";
-
 		CefRefPtr<CefV8Value> callback = callbackMap[callbackID];
 		CefV8ValueList args;
 
-		context->Eval(script, browser->GetMainFrame()->GetURL(), 0,
-			      retval, exception);
-
-		args.push_back(retval);
+		auto ping = pingStart.find(callbackID);
+		if (ping != pingStart.end()) {
+			/* obsstudio.ping() gets the round trip in ms */
+			std::chrono::duration<double, std::milli> rtt =
+				std::chrono::steady_clock::now() -
+				ping->second.start;
+			args.push_back(CefV8Value::CreateDouble(rtt.count()));
+			pingStart.erase(ping);
+		} else {
+			std::string script;
+			script += "JSON.parse('";
+			script += arguments->GetString(1).ToString();
+			script += "');";
+
+			context->Eval(script,
+				      browser->GetMainFrame()->GetURL(), 0,
+				      retval, exception);
+
+			args.push_back(retval);
+		}
 
 		if (callback)
 			callback->ExecuteFunction(nullptr, args);
@@ -363,6 +452,11 @@ bool BrowserApp::Execute(const CefString &name, CefRefPtr<CefV8Value>,
 		if (arguments.size() >= 1 && arguments[0]->IsFunction()) {
 			callbackId++;
 			callbackMap[callbackId] = arguments[0];
+
+			if (name == "ping")
+				pingStart[callbackId] = {
+					std::chrono::steady_clock::now(),
+					CefV8Context::GetCurrentContext()};
 		}
 
 		CefRefPtr<CefProcessMessage> msg =
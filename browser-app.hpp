@@ -19,6 +19,7 @@
 #pragma once
 
 #include <map>
+#include <chrono>
 #include <unordered_map>
 #include <functional>
 #include "cef-headers.hpp"
@@ -78,6 +79,21 @@ class BrowserApp : public CefApp,
 	CallbackMap callbackMap;
 	int callbackId;
 
+	/* pending obsstudio.ping() calls, by callback id.  The context is
+	 * kept so calls whose page went away before the answer can be
+	 * dropped */
+	struct PendingPing {
+		std::chrono::steady_clock::time_point start;
+		CefRefPtr<CefV8Context> context;
+	};
+	std::unordered_map<int, PendingPing> pingStart;
+
+	/* URI-encoded custom CSS per browser, from the browser's extra_info */
+	std::unordered_map<int, std::string> browserCSS;
+
+	void InjectCSS(CefRefPtr<CefV8Context> context,
+		       const std::string &css);
+
 public:
 	inline BrowserApp(bool shared_texture_available_ = false)
 		: shared_texture_available(shared_texture_available_)
@@ -95,9 +111,17 @@ public:
 	virtual void OnBeforeCommandLineProcessing(
 		const CefString &process_type,
 		CefRefPtr<CefCommandLine> command_line) override;
+	virtual void
+	OnBrowserCreated(CefRefPtr<CefBrowser> browser,
+			 CefRefPtr<CefDictionaryValue> extra_info) override;
+	virtual void OnBrowserDestroyed(CefRefPtr<CefBrowser> browser) override;
 	virtual void OnContextCreated(CefRefPtr<CefBrowser> browser,
 				      CefRefPtr<CefFrame> frame,
 				      CefRefPtr<CefV8Context> context) override;
+	virtual void
+	OnContextReleased(CefRefPtr<CefBrowser> browser,
+			  CefRefPtr<CefFrame> frame,
+			  CefRefPtr<CefV8Context> context) override;
 	virtual bool
 	OnProcessMessageReceived(CefRefPtr<CefBrowser> browser,
 				 CefRefPtr<CefFrame> frame,
@@ -0,0 +1,287 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "browser-asset-cache.hpp"
+#include "browser-scheme.hpp"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#if CHROME_VERSION_BUILD >= 4638
+/* ========================================================================= */
+
+#define ASSET_CACHE_MAX_BYTES (128 * 1024 * 1024)
+#define ASSET_CACHE_MAX_ENTRY_BYTES (8 * 1024 * 1024)
+#define ASSET_CACHE_MIN_MAX_AGE 31536000LL
+#define ASSET_CACHE_MIN_HASH_LEN 8
+
+typedef std::shared_ptr<const std::vector<char>> AssetData;
+
+struct CachedAsset {
+	std::string url;
+	std::string mime_type;
+	CefResponse::HeaderMap headers;
+	AssetData data;
+};
+
+typedef std::list<CachedAsset> AssetCacheList;
+
+static std::mutex asset_cache_mutex;
+static AssetCacheList asset_cache;
+static std::unordered_map<std::string, AssetCacheList::iterator>
+	asset_cache_map;
+static size_t asset_cache_bytes = 0;
+
+static void EraseCachedAsset(AssetCacheList::iterator entry)
+{
+	asset_cache_bytes -= entry->data->size();
+	asset_cache_map.erase(entry->url);
+	asset_cache.erase(entry);
+}
+
+/* ========================================================================= */
+
+static std::string ToLower(std::string str)
+{
+	for (char &ch : str)
+		ch = (char)tolower((unsigned char)ch);
+	return str;
+}
+
+static inline bool HasDirective(const std::string &cache_control,
+				const char *directive)
+{
+	return cache_control.find(directive) != std::string::npos;
+}
+
+static long long GetMaxAge(const std::string &cache_control)
+{
+	size_t pos = cache_control.find("max-age=");
+	if (pos == std::string::npos)
+		return -1;
+
+	return strtoll(cache_control.c_str() + pos + 8, nullptr, 10);
+}
+
+static const char *hashed_asset_extensions[] = {
+	".js",  ".mjs", ".css",  ".woff", ".woff2", ".ttf", ".otf",
+	".png", ".jpg", ".jpeg", ".gif",  ".webp",  ".avif", ".svg",
+	".ico", ".mp3", ".ogg",  ".wav",  ".mp4",   ".webm", ".wasm",
+	".json",
+};
+
+static bool HasHashedAssetExtension(const std::string &name, size_t &ext)
+{
+	ext = name.rfind('.');
+	if (ext == std::string::npos || ext == 0)
+		return false;
+
+	std::string lower = ToLower(name.substr(ext));
+	for (const char *known : hashed_asset_extensions) {
+		if (lower == known)
+			return true;
+	}
+	return false;
+}
+
+static inline bool IsHashSeparator(char ch)
+{
+	return ch == '.' || ch == '-' || ch == '_';
+}
+
+/* Matches build-tool style fingerprints such as app.3f9a2c1b.js or
+ * main-3f9a2c1b7e.css: a separate run of hex digits with at least one
+ * letter, in the file name of a static asset.  Numeric IDs such as
+ * /api/users/12345678 and anything with a query string don't count. */
+static bool HasHashedPath(const std::string &url)
+{
+	size_t end = url.find('#');
+	if (end == std::string::npos)
+		end = url.size();
+	if (url.find('?') < end)
+		return false;
+
+	size_t slash = url.rfind('/', end - 1);
+	size_t scheme = url.find("://");
+	if (slash == std::string::npos ||
+	    (scheme != std::string::npos && slash < scheme + 3))
+		return false;
+
+	std::string name = url.substr(slash + 1, end - slash - 1);
+	size_t ext;
+	if (!HasHashedAssetExtension(name, ext))
+		return false;
+
+	size_t run = 0;
+	bool letter = false;
+	bool hex = true;
+	for (size_t i = 0; i <= ext; i++) {
+		char ch = name[i];
+
+		if (i == ext || IsHashSeparator(ch)) {
+			if (hex && letter && run >= ASSET_CACHE_MIN_HASH_LEN)
+				return true;
+			run = 0;
+			letter = false;
+			hex = true;
+		} else if (isxdigit((unsigned char)ch)) {
+			run++;
+			letter |= !!isalpha((unsigned char)ch);
+		} else {
+			hex = false;
+		}
+	}
+
+	return false;
+}
+
+bool AssetCacheWantsRequest(AssetCachePolicy policy,
+			    CefRefPtr<CefRequest> request)
+{
+	if (policy == AssetCachePolicy::Disabled)
+		return false;
+	if (request->GetMethod() != "GET")
+		return false;
+
+	std::string url = request->GetURL();
+	return url.compare(0, 7, "http://") == 0 ||
+	       url.compare(0, 8, "https://") == 0;
+}
+
+bool AssetCacheWantsResponse(AssetCachePolicy policy,
+			     CefRefPtr<CefRequest> request,
+			     CefRefPtr<CefResponse> response)
+{
+	if (!AssetCacheWantsRequest(policy, request))
+		return false;
+	if (response->GetStatus() != 200)
+		return false;
+
+	std::string cache_control =
+		ToLower(response->GetHeaderByName("Cache-Control"));
+	if (HasDirective(cache_control, "no-store") ||
+	    HasDirective(cache_control, "private"))
+		return false;
+
+	if (HasDirective(cache_control, "immutable") ||
+	    GetMaxAge(cache_control) >= ASSET_CACHE_MIN_MAX_AGE)
+		return true;
+
+	return policy == AssetCachePolicy::ImmutableAndHashed &&
+	       !HasDirective(cache_control, "no-cache") &&
+	       HasHashedPath(request->GetURL());
+}
+
+/* ========================================================================= */
+
+CefRefPtr<CefResourceHandler> AssetCacheLookup(CefRefPtr<CefRequest> request)
+{
+	std::string url = request->GetURL();
+	std::lock_guard<std::mutex> lock(asset_cache_mutex);
+
+	auto it = asset_cache_map.find(url);
+	if (it == asset_cache_map.end())
+		return nullptr;
+
+	asset_cache.splice(asset_cache.begin(), asset_cache, it->second);
+
+	const CachedAsset &asset = *it->second;
+	return CreateMemoryResourceHandler(asset.data, asset.data->data(),
+					   asset.data->size(), asset.mime_type,
+					   asset.headers);
+}
+
+void AssetCacheStore(CefRefPtr<CefRequest> request,
+		     CefRefPtr<CefResponse> response, std::vector<char> &&data)
+{
+	if (data.empty() || data.size() > ASSET_CACHE_MAX_ENTRY_BYTES)
+		return;
+
+	CefResponse::HeaderMap all_headers;
+	CefResponse::HeaderMap headers;
+	response->GetHeaderMap(all_headers);
+
+	/* the filter sees the decoded body, and the length and type are
+	 * supplied by the resource handler */
+	for (auto &header : all_headers) {
+		std::string name = ToLower(header.first);
+		if (name == "content-length" || name == "content-encoding" ||
+		    name == "transfer-encoding" || name == "content-type" ||
+		    name == "set-cookie")
+			continue;
+		headers.insert(header);
+	}
+
+	CachedAsset asset;
+	asset.url = request->GetURL();
+	asset.mime_type = response->GetMimeType();
+	asset.headers = std::move(headers);
+	asset.data = std::make_shared<const std::vector<char>>(std::move(data));
+
+	std::lock_guard<std::mutex> lock(asset_cache_mutex);
+
+	auto it = asset_cache_map.find(asset.url);
+	if (it != asset_cache_map.end())
+		EraseCachedAsset(it->second);
+
+	asset_cache_bytes += asset.data->size();
+	asset_cache.push_front(std::move(asset));
+	asset_cache_map[asset_cache.front().url] = asset_cache.begin();
+
+	while (asset_cache_bytes > ASSET_CACHE_MAX_BYTES)
+		EraseCachedAsset(std::prev(asset_cache.end()));
+}
+
+/* ========================================================================= */
+
+bool AssetCacheFilter::InitFilter()
+{
+	return true;
+}
+
+CefResponseFilter::FilterStatus
+AssetCacheFilter::Filter(void *data_in, size_t data_in_size,
+			 size_t &data_in_read, void *data_out,
+			 size_t data_out_size, size_t &data_out_written)
+{
+	size_t count = std::min(data_in_size, data_out_size);
+
+	if (count) {
+		memcpy(data_out, data_in, count);
+
+		if (!overflow) {
+			if (data.size() + count > ASSET_CACHE_MAX_ENTRY_BYTES) {
+				overflow = true;
+				std::vector<char>().swap(data);
+			} else {
+				const char *in = (const char *)data_in;
+				data.insert(data.end(), in, in + count);
+			}
+		}
+	}
+
+	data_in_read = count;
+	data_out_written = count;
+
+	return count < data_in_size ? RESPONSE_FILTER_NEED_MORE_DATA
+				    : RESPONSE_FILTER_DONE;
+}
+#endif
@@ -0,0 +1,55 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include "cef-headers.hpp"
+#include "obs-browser-source.hpp"
+#include <vector>
+
+#if CHROME_VERSION_BUILD >= 4638
+/* In-process cache of remote assets shared by all browser sources.  Assets
+ * the policy considers pinned are served from memory even when the page is
+ * reloaded with ReloadIgnoreCache. */
+
+class AssetCacheFilter : public CefResponseFilter {
+	std::vector<char> data;
+	bool overflow = false;
+
+public:
+	virtual bool InitFilter() override;
+	virtual FilterStatus Filter(void *data_in, size_t data_in_size,
+				    size_t &data_in_read, void *data_out,
+				    size_t data_out_size,
+				    size_t &data_out_written) override;
+
+	inline bool Complete() const { return !overflow; }
+	inline std::vector<char> &Data() { return data; }
+
+	IMPLEMENT_REFCOUNTING(AssetCacheFilter);
+};
+
+extern bool AssetCacheWantsRequest(AssetCachePolicy policy,
+				   CefRefPtr<CefRequest> request);
+extern bool AssetCacheWantsResponse(AssetCachePolicy policy,
+				    CefRefPtr<CefRequest> request,
+				    CefRefPtr<CefResponse> response);
+
+extern CefRefPtr<CefResourceHandler>
+AssetCacheLookup(CefRefPtr<CefRequest> request);
+extern void AssetCacheStore(CefRefPtr<CefRequest> request,
+			    CefRefPtr<CefResponse> response,
+			    std::vector<char> &&data);
+#endif
@@ -0,0 +1,235 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "browser-bundle.hpp"
+#include "browser-scheme.hpp"
+#include <obs-module.h>
+#include <util/platform.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#if CHROME_VERSION_BUILD >= 4638
+/* ========================================================================= */
+/* Minimal zip reader: only the central directory is read into memory,
+ * entry data is read with positional reads on request. */
+
+#define ZIP_EOCD_SIG 0x06054b50
+#define ZIP_CDIR_SIG 0x02014b50
+#define ZIP_LOCAL_SIG 0x04034b50
+#define ZIP_EOCD_SIZE 22
+#define ZIP_CDIR_SIZE 46
+#define ZIP_LOCAL_SIZE 30
+#define ZIP_MAX_COMMENT 0xFFFF
+
+static inline uint16_t ReadU16(const char *p)
+{
+	const uint8_t *b = (const uint8_t *)p;
+	return (uint16_t)(b[0] | (b[1] << 8));
+}
+
+static inline uint32_t ReadU32(const char *p)
+{
+	const uint8_t *b = (const uint8_t *)p;
+	return (uint32_t)b[0] | ((uint32_t)b[1] << 8) |
+	       ((uint32_t)b[2] << 16) | ((uint32_t)b[3] << 24);
+}
+
+static bool ReadAll(const FileReader &file, std::vector<char> &buf,
+		    uint64_t offset)
+{
+	size_t done = 0;
+	while (done < buf.size()) {
+		size_t read = file.Read(buf.data() + done, buf.size() - done,
+					offset + done);
+		if (!read)
+			return false;
+		done += read;
+	}
+	return true;
+}
+
+bool AssetBundle::Load()
+{
+	const uint64_t size = file->size;
+
+	if (size < ZIP_EOCD_SIZE)
+		return false;
+
+	/* the end of central directory record is followed by a comment of
+	 * up to 64 KB */
+	uint64_t tail_size = std::min<uint64_t>(size, ZIP_EOCD_SIZE +
+							      ZIP_MAX_COMMENT);
+	std::vector<char> tail((size_t)tail_size);
+	if (!ReadAll(*file, tail, size - tail_size))
+		return false;
+
+	size_t eocd = tail.size() - ZIP_EOCD_SIZE;
+	while (ReadU32(tail.data() + eocd) != ZIP_EOCD_SIG) {
+		if (!eocd)
+			return false;
+		eocd--;
+	}
+
+	size_t count = ReadU16(tail.data() + eocd + 10);
+	uint64_t cdir_size = ReadU32(tail.data() + eocd + 12);
+	uint64_t cdir_offset = ReadU32(tail.data() + eocd + 16);
+	if (cdir_offset + cdir_size > size)
+		return false;
+
+	std::vector<char> cdir((size_t)cdir_size);
+	if (!ReadAll(*file, cdir, cdir_offset))
+		return false;
+
+	const char *data = cdir.data();
+	size_t pos = 0;
+	size_t skipped = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		if (pos + ZIP_CDIR_SIZE > cdir.size() ||
+		    ReadU32(data + pos) != ZIP_CDIR_SIG)
+			return false;
+
+		uint16_t flags = ReadU16(data + pos + 8);
+		uint16_t method = ReadU16(data + pos + 10);
+		uint32_t comp_size = ReadU32(data + pos + 20);
+		uint32_t real_size = ReadU32(data + pos + 24);
+		size_t name_len = ReadU16(data + pos + 28);
+		size_t extra_len = ReadU16(data + pos + 30);
+		size_t comment_len = ReadU16(data + pos + 32);
+		uint64_t local = ReadU32(data + pos + 42);
+
+		if (pos + ZIP_CDIR_SIZE + name_len > cdir.size())
+			return false;
+
+		std::string name(data + pos + ZIP_CDIR_SIZE, name_len);
+		pos += ZIP_CDIR_SIZE + name_len + extra_len + comment_len;
+
+		if (name.empty() || name.back() == '/')
+			continue;
+
+		/* compressed, encrypted and zip64 entries can't be served
+		 * straight from the file */
+		if (method != 0 || (flags & 1) || comp_size != real_size ||
+		    comp_size == 0xFFFFFFFF ||
+		    local + ZIP_LOCAL_SIZE + comp_size > size) {
+			skipped++;
+			continue;
+		}
+
+		entries[name] = {local, comp_size};
+	}
+
+	if (skipped)
+		blog(LOG_WARNING,
+		     "[obs-browser]: Bundle '%s': skipped %zu compressed or "
+		     "unsupported entries, store them uncompressed (zip -0)",
+		     path.c_str(), skipped);
+
+	return true;
+}
+
+/* ========================================================================= */
+
+static std::mutex bundles_mutex;
+static std::unordered_map<std::string, std::weak_ptr<AssetBundle>> bundles;
+
+std::shared_ptr<AssetBundle> AssetBundle::Open(const std::string &path)
+{
+	struct stat st;
+	if (os_stat(path.c_str(), &st) != 0) {
+		blog(LOG_WARNING, "[obs-browser]: Bundle '%s' not found",
+		     path.c_str());
+		return nullptr;
+	}
+
+	std::lock_guard<std::mutex> lock(bundles_mutex);
+
+	std::shared_ptr<AssetBundle> bundle = bundles[path].lock();
+	if (bundle && bundle->file_size == (int64_t)st.st_size &&
+	    bundle->file_mtime == GetFileMTime(path, st))
+		return bundle;
+
+	bundle = std::make_shared<AssetBundle>();
+	bundle->path = path;
+	bundle->file_size = (int64_t)st.st_size;
+	bundle->file_mtime = GetFileMTime(path, st);
+	bundle->file = FileReader::Open(path);
+
+	if (!bundle->file || !bundle->Load()) {
+		blog(LOG_WARNING, "[obs-browser]: Failed to open bundle '%s'",
+		     path.c_str());
+		return nullptr;
+	}
+
+	bundles[path] = bundle;
+	return bundle;
+}
+
+static std::string DecodePath(const std::string &url_path)
+{
+	std::string name = CefURIDecode(
+		url_path, true, cef_uri_unescape_rule_t::UU_SPACES);
+	name = CefURIDecode(
+		name, true,
+		cef_uri_unescape_rule_t::
+			UU_URL_SPECIAL_CHARS_EXCEPT_PATH_SEPARATORS);
+
+	size_t start = name.find_first_not_of('/');
+	name = start == std::string::npos ? std::string() : name.substr(start);
+
+	if (name.empty() || name.back() == '/')
+		name += "index.html";
+	return name;
+}
+
+const AssetBundle::Entry *AssetBundle::Find(const std::string &name) const
+{
+	auto it = entries.find(name);
+	return it != entries.end() ? &it->second : nullptr;
+}
+
+bool AssetBundle::Contains(const std::string &url_path) const
+{
+	return Find(DecodePath(url_path)) != nullptr;
+}
+
+CefRefPtr<CefResourceHandler>
+AssetBundle::GetResourceHandler(const std::string &url_path) const
+{
+	std::string name = DecodePath(url_path);
+	const Entry *entry = Find(name);
+	if (!entry)
+		return nullptr;
+
+	/* the local header repeats the name and has its own extra field, the
+	 * data follows them */
+	std::vector<char> local(ZIP_LOCAL_SIZE);
+	if (!ReadAll(*file, local, entry->local) ||
+	    ReadU32(local.data()) != ZIP_LOCAL_SIG)
+		return nullptr;
+
+	uint64_t offset = entry->local + ZIP_LOCAL_SIZE +
+			  ReadU16(local.data() + 26) +
+			  ReadU16(local.data() + 28);
+	if (offset + entry->size > file->size)
+		return nullptr;
+
+	return CreateFileResourceHandler(file, offset, entry->size,
+					 GetFileMimeType(name));
+}
+#endif
@@ -0,0 +1,64 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include "cef-headers.hpp"
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+#define BUNDLE_HOST "bundle"
+
+class AssetBundle;
+
+#if CHROME_VERSION_BUILD >= 4638
+class FileReader;
+
+/* A zip archive of overlay assets served from http://bundle/.  Entries must
+ * be stored uncompressed (zip -0) so they can be read straight from the
+ * file.  Only the central directory is kept in memory.
+ *
+ * The file stays open while sources use it.  Replace a deployed bundle
+ * atomically (write a new file and rename it over the old one): sources
+ * keep reading the old file until they're recreated.  A bundle rewritten
+ * in place can't crash OBS, but pages still loading from it may get
+ * truncated or mismatched files. */
+class AssetBundle : public std::enable_shared_from_this<AssetBundle> {
+	struct Entry {
+		uint64_t local; /* offset of the local file header */
+		size_t size;
+	};
+
+	std::string path;
+	int64_t file_size = 0;
+	int64_t file_mtime = 0;
+	std::shared_ptr<FileReader> file;
+	std::unordered_map<std::string, Entry> entries;
+
+	bool Load();
+	const Entry *Find(const std::string &name) const;
+
+public:
+	/* Bundles are shared between sources until the file changes */
+	static std::shared_ptr<AssetBundle> Open(const std::string &path);
+
+	/* |url_path| is the still-encoded path of an http://bundle/ URL */
+	bool Contains(const std::string &url_path) const;
+	CefRefPtr<CefResourceHandler>
+	GetResourceHandler(const std::string &url_path) const;
+};
+#endif
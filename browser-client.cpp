@@ -18,6 +18,7 @@
 
 #include "browser-client.hpp"
 #include "obs-browser-source.hpp"
+#include "browser-trace.hpp"
 #include "base64/base64.hpp"
 #include "json11/json11.hpp"
 #include <obs-frontend-api.h>
@@ -26,9 +27,6 @@
 #include <QApplication>
 #include <QThread>
 #include <QToolTip>
-#if defined(__APPLE__) && CHROME_VERSION_BUILD > 4430
-#include <IOSurface/IOSurface.h>
-#endif
 
 using namespace json11;
 
@@ -37,11 +35,6 @@ inline bool BrowserClient::valid() const
 	return !!bs && !bs->destroying;
 }
 
-CefRefPtr<CefLoadHandler> BrowserClient::GetLoadHandler()
-{
-	return this;
-}
-
 CefRefPtr<CefRenderHandler> BrowserClient::GetRenderHandler()
 {
 	return this;
@@ -67,12 +60,91 @@ CefRefPtr<CefAudioHandler> BrowserClient::GetAudioHandler()
 	return reroute_audio ? this : nullptr;
 }
 
-#if CHROME_VERSION_BUILD >= 4638
 CefRefPtr<CefRequestHandler> BrowserClient::GetRequestHandler()
 {
 	return this;
 }
 
+class DelayedTask : public CefTask {
+	std::function<void()> func;
+
+public:
+	inline DelayedTask(std::function<void()> func_) : func(func_) {}
+	virtual void Execute() override { func(); }
+
+	IMPLEMENT_REFCOUNTING(DelayedTask);
+};
+
+static const char *TerminationReason(cef_termination_status_t status)
+{
+	switch (status) {
+	case TS_ABNORMAL_TERMINATION:
+		return "abnormal termination";
+	case TS_PROCESS_WAS_KILLED:
+		return "killed";
+	case TS_PROCESS_CRASHED:
+		return "crashed";
+	case TS_PROCESS_OOM:
+		return "out of memory";
+	default:
+		return "unknown";
+	}
+}
+
+/* The page is reloaded after a delay that doubles with every crash in a
+ * row, so a widget that keeps crashing doesn't keep a core busy
+ * restarting its renderer.  The streak resets once a renderer survived
+ * CRASH_STREAK_RESET_NS. */
+#define CRASH_BACKOFF_MIN_MS 1000
+#define CRASH_BACKOFF_MAX_MS 60000
+#define CRASH_STREAK_RESET_NS 300000000000ULL
+
+void BrowserClient::OnRenderProcessTerminated(CefRefPtr<CefBrowser> browser,
+					      TerminationStatus status)
+{
+	if (!valid())
+		return;
+
+	uint64_t now = os_gettime_ns();
+	if (last_crash_ts && now - last_crash_ts >= CRASH_STREAK_RESET_NS)
+		crash_streak = 0;
+	last_crash_ts = now;
+
+	int delay = CRASH_BACKOFF_MIN_MS;
+	for (int i = 0; i < crash_streak && delay < CRASH_BACKOFF_MAX_MS; i++)
+		delay *= 2;
+	if (delay > CRASH_BACKOFF_MAX_MS)
+		delay = CRASH_BACKOFF_MAX_MS;
+	crash_streak++;
+
+	const char *reason = TerminationReason(status);
+	uint64_t crashes = ++bs->stats.renderer_crashes;
+	bs->stats.renderer_pid = 0;
+
+	blog(LOG_WARNING,
+	     "[obs-browser]: '%s' renderer process terminated (%s), "
+	     "reloading in %d ms",
+	     obs_source_get_name(bs->source), reason, delay);
+
+	calldata_t cd = {};
+	calldata_set_ptr(&cd, "source", bs->source);
+	calldata_set_string(&cd, "reason", reason);
+	calldata_set_int(&cd, "count", (long long)crashes);
+	signal_handler_signal(obs_source_get_signal_handler(bs->source),
+			      "renderer_terminated", &cd);
+	calldata_free(&cd);
+
+	/* the old client is invalid by then if the source was removed or
+	 * its browser recreated in the meantime */
+	CefRefPtr<BrowserClient> self = this;
+	CefRefPtr<CefTask> reload = new DelayedTask([self, browser]() {
+		if (self->valid())
+			browser->Reload();
+	});
+	CefPostDelayedTask(TID_UI, reload, delay);
+}
+
+#if CHROME_VERSION_BUILD >= 4638
 CefRefPtr<CefResourceRequestHandler> BrowserClient::GetResourceRequestHandler(
 	CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>,
 	CefRefPtr<CefRequest> request, bool, bool, const CefString &, bool &)
@@ -80,16 +152,116 @@ CefRefPtr<CefResourceRequestHandler> BrowserClient::GetResourceRequestHandler(
 	if (request->GetHeaderByName("origin") == "null") {
 		return this;
 	}
+	if (request_rules || bundle ||
+	    AssetCacheWantsRequest(asset_cache_policy, request)) {
+		return this;
+	}
 
 	return nullptr;
 }
 
 CefResourceRequestHandler::ReturnValue BrowserClient::OnBeforeResourceLoad(
-	CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>, CefRefPtr<CefRequest>,
-	CefRefPtr<CefCallback>)
+	CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>,
+	CefRefPtr<CefRequest> request, CefRefPtr<CefCallback>)
 {
+	if (!request_rules && !bundle)
+		return RV_CONTINUE;
+
+	std::string url = request->GetURL();
+	CefURLParts parts;
+	if (!CefParseURL(url, parts))
+		return RV_CONTINUE;
+
+	/* bundle requests must never fall through to the network */
+	std::string host = CefString(&parts.host);
+	if (host == BUNDLE_HOST) {
+		std::string path = CefString(&parts.path);
+		return bundle && bundle->Contains(path) ? RV_CONTINUE
+							: RV_CANCEL;
+	}
+
+	/* never rewrite local files, redirects point there */
+	if (!request_rules || host == "absolute")
+		return RV_CONTINUE;
+
+	request_rules->Match(url, host, rule_matches);
+
+	for (int idx : rule_matches) {
+		const RequestRule &rule = request_rules->Rule(idx);
+
+		switch (rule.type) {
+		case RequestRuleType::Block:
+			return RV_CANCEL;
+		case RequestRuleType::Header:
+			request->SetHeaderByName(rule.name, rule.value, true);
+			break;
+		case RequestRuleType::Redirect:
+			request->SetURL(rule.value);
+			return RV_CONTINUE;
+		}
+	}
+
 	return RV_CONTINUE;
 }
+
+CefRefPtr<CefResourceHandler>
+BrowserClient::GetResourceHandler(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>,
+				  CefRefPtr<CefRequest> request)
+{
+	if (bundle) {
+		CefURLParts parts;
+		CefParseURL(request->GetURL(), parts);
+
+		std::string host = CefString(&parts.host);
+		if (host == BUNDLE_HOST)
+			return bundle->GetResourceHandler(
+				CefString(&parts.path));
+	}
+
+	if (!AssetCacheWantsRequest(asset_cache_policy, request))
+		return nullptr;
+
+	/* pinned assets are served from memory even on ReloadIgnoreCache */
+	CefRefPtr<CefResourceHandler> handler = AssetCacheLookup(request);
+	if (handler)
+		asset_cache_hits.insert(request->GetIdentifier());
+	return handler;
+}
+
+CefRefPtr<CefResponseFilter> BrowserClient::GetResourceResponseFilter(
+	CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>,
+	CefRefPtr<CefRequest> request, CefRefPtr<CefResponse> response)
+{
+	uint64_t id = request->GetIdentifier();
+	if (asset_cache_hits.count(id))
+		return nullptr;
+	if (!AssetCacheWantsResponse(asset_cache_policy, request, response))
+		return nullptr;
+
+	CefRefPtr<AssetCacheFilter> filter = new AssetCacheFilter;
+	asset_filters[id] = filter;
+	return filter;
+}
+
+void BrowserClient::OnResourceLoadComplete(CefRefPtr<CefBrowser>,
+					   CefRefPtr<CefFrame>,
+					   CefRefPtr<CefRequest> request,
+					   CefRefPtr<CefResponse> response,
+					   URLRequestStatus status, int64)
+{
+	uint64_t id = request->GetIdentifier();
+	asset_cache_hits.erase(id);
+
+	auto it = asset_filters.find(id);
+	if (it == asset_filters.end())
+		return;
+
+	CefRefPtr<AssetCacheFilter> filter = it->second;
+	asset_filters.erase(it);
+
+	if (status == UR_SUCCESS && filter->Complete())
+		AssetCacheStore(request, response, std::move(filter->Data()));
+}
 #endif
 
 bool BrowserClient::OnBeforePopup(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>,
@@ -124,6 +296,24 @@ bool BrowserClient::OnProcessMessageReceived(
 		return false;
 	}
 
+	bs->stats.ipc_in++;
+	TRACE_SCOPE("OnProcessMessageReceived");
+
+	if (name == "Pong") {
+		BrowserStats &stats = bs->stats;
+		uint64_t sent = stats.ping_sent_ts;
+		if (input_args->GetInt(0) == stats.ping_id && sent &&
+		    stats.ping_sent_ts.compare_exchange_strong(sent, 0))
+			stats.ipc_rtt.Add((os_gettime_ns() - sent) / 1000);
+		return true;
+	} else if (name == "RendererInfo") {
+		int pid = input_args->GetInt(0);
+		if (bs->stats.renderer_pid.exchange(pid) != pid)
+			blog(LOG_DEBUG, "[obs-browser]: '%s' renderer pid: %d",
+			     obs_source_get_name(bs->source), pid);
+		return true;
+	}
+
 	// Fall-through switch, so that higher levels also have lower-level rights
 	switch (webpage_control_level) {
 	case ControlLevel::All:
@@ -280,6 +470,7 @@ bool BrowserClient::OnProcessMessageReceived(
 	execute_args->SetString(1, json.dump());
 
 	SendBrowserProcessMessage(browser, PID_RENDERER, msg);
+	bs->stats.ipc_out++;
 
 	return true;
 }
@@ -319,6 +510,8 @@ void BrowserClient::OnPaint(CefRefPtr<CefBrowser>, PaintElementType type,
 		return;
 	}
 
+	TRACE_SCOPE("OnPaint");
+
 #ifdef SHARED_TEXTURE_SUPPORT_ENABLED
 	if (sharing_available) {
 		return;
@@ -329,26 +522,18 @@ void BrowserClient::OnPaint(CefRefPtr<CefBrowser>, PaintElementType type,
 		return;
 	}
 
-	if (bs->width != width || bs->height != height) {
-		obs_enter_graphics();
-		bs->DestroyTextures();
-		obs_leave_graphics();
-	}
+	bs->last_frame_ts = os_gettime_ns();
+	bs->stats.paints++;
 
-	if (!bs->texture && width && height) {
-		obs_enter_graphics();
-		bs->texture = gs_texture_create(width, height, GS_BGRA, 1,
-						(const uint8_t **)&buffer,
-						GS_DYNAMIC);
-		bs->width = width;
-		bs->height = height;
-		obs_leave_graphics();
-	} else {
-		obs_enter_graphics();
-		gs_texture_set_image(bs->texture, (const uint8_t *)buffer,
-				     width * 4, false);
-		obs_leave_graphics();
+	if (bs->sync_av) {
+		bs->QueueFrame(buffer, width, height, bs->last_frame_ts);
+		return;
 	}
+
+	obs_enter_graphics();
+	bs->stats.graphics_wait_ns += os_gettime_ns() - bs->last_frame_ts;
+	bs->UploadFrame(buffer, width, height, bs->last_frame_ts);
+	obs_leave_graphics();
 }
 
 #ifdef SHARED_TEXTURE_SUPPORT_ENABLED
@@ -361,65 +546,63 @@ void BrowserClient::OnAcceleratedPaint(CefRefPtr<CefBrowser>,
 		return;
 	}
 
+	TRACE_SCOPE("OnAcceleratedPaint");
+
 	if (!valid()) {
 		return;
 	}
 
+	bs->last_frame_ts = os_gettime_ns();
+	bs->stats.paints++;
+
 #ifndef _WIN32
-	if (shared_handle == last_handle)
+	/* CEF drew into the surface we already have, it's still a new
+	 * frame for the render cache and the frame age */
+	if (shared_handle == last_handle) {
+		bs->frame_ts = bs->last_frame_ts;
+		bs->frame_gen++;
 		return;
+	}
 #endif
 
 	obs_enter_graphics();
+	uint64_t locked = os_gettime_ns();
+	bs->stats.graphics_wait_ns += locked - bs->last_frame_ts;
+	bs->SetSharedTexture(shared_handle, bs->last_frame_ts);
+	bs->stats.upload_ns += os_gettime_ns() - locked;
+	obs_leave_graphics();
 
-	if (bs->texture) {
-		if (bs->extra_texture) {
-			gs_texture_destroy(bs->extra_texture);
-			bs->extra_texture = nullptr;
-		}
-#ifdef _WIN32
-		gs_texture_release_sync(bs->texture, 0);
-#endif
-		gs_texture_destroy(bs->texture);
-#ifdef _WIN32
-		CloseHandle(extra_handle);
+	last_handle = shared_handle;
+}
 #endif
-		bs->texture = nullptr;
-	}
 
-#if defined(__APPLE__) && CHROME_VERSION_BUILD > 4183
-	bs->texture = gs_texture_create_from_iosurface(
-		(IOSurfaceRef)(uintptr_t)shared_handle);
-#elif defined(_WIN32) && CHROME_VERSION_BUILD > 4183
-	DuplicateHandle(GetCurrentProcess(), (HANDLE)(uintptr_t)shared_handle,
-			GetCurrentProcess(), &extra_handle, 0, false,
-			DUPLICATE_SAME_ACCESS);
-
-	bs->texture =
-		gs_texture_open_nt_shared((uint32_t)(uintptr_t)shared_handle);
-	gs_texture_acquire_sync(bs->texture, 1, INFINITE);
-#else
-	bs->texture =
-		gs_texture_open_shared((uint32_t)(uintptr_t)shared_handle);
-#endif
+static inline uint64_t GetAudioTimestamp(BrowserSource *bs, int64_t pts)
+{
+	uint64_t timestamp = (uint64_t)pts * 1000000LLU;
 
-	if (bs->texture) {
-		const uint32_t cx = gs_texture_get_width(bs->texture);
-		const uint32_t cy = gs_texture_get_height(bs->texture);
-		const gs_color_format format =
-			gs_texture_get_color_format(bs->texture);
-		const gs_color_format linear_format =
-			gs_generalize_format(format);
-		if (linear_format != format) {
-			bs->extra_texture = gs_texture_create(
-				cx, cy, linear_format, 1, nullptr, 0);
-		}
-	}
-	obs_leave_graphics();
+	/* a negative sync offset delays audio rather than video, but only
+	 * audio OBS controls is this source's to delay */
+	if (bs->reroute_audio && bs->sync_av && bs->sync_av_offset < 0)
+		timestamp += (uint64_t)(-bs->sync_av_offset) * 1000000LLU;
 
-	last_handle = shared_handle;
+	return timestamp;
+}
+
+/* Counts packets, and gaps of more than half a packet between consecutive
+ * packets as underruns */
+void BrowserClient::CountAudioPacket(uint64_t timestamp, int frames,
+				     int sample_rate)
+{
+	uint64_t duration =
+		sample_rate ? (uint64_t)frames * 1000000000ULL / sample_rate
+			    : 0;
+
+	bs->stats.audio_packets++;
+	if (next_audio_ts && timestamp > next_audio_ts + duration / 2)
+		bs->stats.audio_underruns++;
+
+	next_audio_ts = timestamp + duration;
 }
-#endif
 
 static speaker_layout GetSpeakerLayout(CefAudioHandler::ChannelLayout cefLayout)
 {
@@ -458,6 +641,7 @@ void BrowserClient::OnAudioStreamStarted(CefRefPtr<CefBrowser> browser,
 	channel_layout = (ChannelLayout)params_.channel_layout;
 	sample_rate = params_.sample_rate;
 	frames_per_buffer = params_.frames_per_buffer;
+	next_audio_ts = 0;
 }
 
 void BrowserClient::OnAudioStreamPacket(CefRefPtr<CefBrowser> browser,
@@ -478,7 +662,8 @@ void BrowserClient::OnAudioStreamPacket(CefRefPtr<CefBrowser> browser,
 	audio.frames = frames;
 	audio.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	audio.speakers = speakers;
-	audio.timestamp = (uint64_t)pts * 1000000LLU;
+	audio.timestamp = GetAudioTimestamp(bs, pts);
+	CountAudioPacket(audio.timestamp, frames, sample_rate);
 	obs_source_output_audio(bs->source, &audio);
 }
 
@@ -573,7 +758,8 @@ void BrowserClient::OnAudioStreamPacket(CefRefPtr<CefBrowser> browser, int id,
 	audio.frames = frames;
 	audio.format = AUDIO_FORMAT_FLOAT_PLANAR;
 	audio.speakers = stream.speakers;
-	audio.timestamp = (uint64_t)pts * 1000000LLU;
+	audio.timestamp = GetAudioTimestamp(bs, pts);
+	CountAudioPacket(audio.timestamp, frames, stream.sample_rate);
 
 	obs_source_output_audio(stream.source, &audio);
 }
@@ -606,27 +792,6 @@ void BrowserClient::OnAudioStreamStopped(CefRefPtr<CefBrowser> browser, int id)
 }
 #endif
 
-void BrowserClient::OnLoadEnd(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame> frame,
-			      int)
-{
-	if (!valid()) {
-		return;
-	}
-
-	if (frame->IsMain() && bs->css.length()) {
-		std::string uriEncodedCSS =
-			CefURIEncode(bs->css, false).ToString();
-
-		std::string script;
-		script += "const obsCSS = document.createElement('style');";
-		script += "obsCSS.innerHTML = decodeURIComponent(\"" +
-			  uriEncodedCSS + "\");";
-		script += "document.querySelector('head').appendChild(obsCSS);";
-
-		frame->ExecuteJavaScript(script, "", 0);
-	}
-}
-
 bool BrowserClient::OnConsoleMessage(CefRefPtr<CefBrowser>,
 				     cef_log_severity_t level,
 				     const CefString &message,
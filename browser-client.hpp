@@ -23,6 +23,11 @@
 #include "cef-headers.hpp"
 #include "browser-config.h"
 #include "obs-browser-source.hpp"
+#include "browser-asset-cache.hpp"
+#include "browser-request-rules.hpp"
+#include "browser-bundle.hpp"
+#include <unordered_map>
+#include <unordered_set>
 
 struct BrowserSource;
 
@@ -35,13 +40,11 @@ class BrowserClient : public CefClient,
 #endif
 		      public CefContextMenuHandler,
 		      public CefRenderHandler,
-		      public CefAudioHandler,
-		      public CefLoadHandler {
+		      public CefAudioHandler {
 
 #ifdef SHARED_TEXTURE_SUPPORT_ENABLED
 #ifdef _WIN32
 	void *last_handle = INVALID_HANDLE_VALUE;
-	void *extra_handle = INVALID_HANDLE_VALUE;
 #elif defined(__APPLE__)
 	void *last_handle = nullptr;
 #endif
@@ -49,8 +52,26 @@ class BrowserClient : public CefClient,
 	bool sharing_available = false;
 	bool reroute_audio = true;
 	ControlLevel webpage_control_level = DEFAULT_CONTROL_LEVEL;
+	AssetCachePolicy asset_cache_policy = DEFAULT_ASSET_CACHE_POLICY;
+	std::shared_ptr<const RequestRules> request_rules;
+	std::shared_ptr<AssetBundle> bundle;
+
+#if CHROME_VERSION_BUILD >= 4638
+	/* only touched on the IO thread */
+	std::vector<int> rule_matches;
+	std::unordered_map<uint64_t, CefRefPtr<AssetCacheFilter>> asset_filters;
+	std::unordered_set<uint64_t> asset_cache_hits;
+#endif
+
+	/* audio thread only */
+	uint64_t next_audio_ts = 0;
+
+	/* renderer crash backoff, UI thread only */
+	int crash_streak = 0;
+	uint64_t last_crash_ts = 0;
 
 	inline bool valid() const;
+	void CountAudioPacket(uint64_t timestamp, int frames, int sample_rate);
 
 public:
 	BrowserSource *bs;
@@ -65,22 +86,25 @@ public:
 #endif
 	inline BrowserClient(BrowserSource *bs_, bool sharing_avail,
 			     bool reroute_audio_,
-			     ControlLevel webpage_control_level_)
+			     ControlLevel webpage_control_level_,
+			     AssetCachePolicy asset_cache_policy_,
+			     std::shared_ptr<const RequestRules> request_rules_,
+			     std::shared_ptr<AssetBundle> bundle_)
 		: sharing_available(sharing_avail),
 		  reroute_audio(reroute_audio_),
 		  webpage_control_level(webpage_control_level_),
+		  asset_cache_policy(asset_cache_policy_),
+		  request_rules(request_rules_),
+		  bundle(bundle_),
 		  bs(bs_)
 	{
 	}
 
 	/* CefClient */
-	virtual CefRefPtr<CefLoadHandler> GetLoadHandler() override;
 	virtual CefRefPtr<CefRenderHandler> GetRenderHandler() override;
 	virtual CefRefPtr<CefDisplayHandler> GetDisplayHandler() override;
 	virtual CefRefPtr<CefLifeSpanHandler> GetLifeSpanHandler() override;
-#if CHROME_VERSION_BUILD >= 4638
 	virtual CefRefPtr<CefRequestHandler> GetRequestHandler() override;
-#endif
 	virtual CefRefPtr<CefContextMenuHandler>
 	GetContextMenuHandler() override;
 	virtual CefRefPtr<CefAudioHandler> GetAudioHandler() override;
@@ -111,8 +135,11 @@ public:
 		      CefBrowserSettings &settings,
 		      CefRefPtr<CefDictionaryValue> &extra_info,
 		      bool *no_javascript_access) override;
-#if CHROME_VERSION_BUILD >= 4638
 	/* CefRequestHandler */
+	virtual void
+	OnRenderProcessTerminated(CefRefPtr<CefBrowser> browser,
+				  TerminationStatus status) override;
+#if CHROME_VERSION_BUILD >= 4638
 	virtual CefRefPtr<CefResourceRequestHandler> GetResourceRequestHandler(
 		CefRefPtr<CefBrowser> browser, CefRefPtr<CefFrame> frame,
 		CefRefPtr<CefRequest> request, bool is_navigation,
@@ -125,6 +152,22 @@ public:
 			     CefRefPtr<CefFrame> frame,
 			     CefRefPtr<CefRequest> request,
 			     CefRefPtr<CefCallback> callback) override;
+	virtual CefRefPtr<CefResourceHandler>
+	GetResourceHandler(CefRefPtr<CefBrowser> browser,
+			   CefRefPtr<CefFrame> frame,
+			   CefRefPtr<CefRequest> request) override;
+	virtual CefRefPtr<CefResponseFilter>
+	GetResourceResponseFilter(CefRefPtr<CefBrowser> browser,
+				  CefRefPtr<CefFrame> frame,
+				  CefRefPtr<CefRequest> request,
+				  CefRefPtr<CefResponse> response) override;
+	virtual void
+	OnResourceLoadComplete(CefRefPtr<CefBrowser> browser,
+			       CefRefPtr<CefFrame> frame,
+			       CefRefPtr<CefRequest> request,
+			       CefRefPtr<CefResponse> response,
+			       URLRequestStatus status,
+			       int64 received_content_length) override;
 #endif
 
 	/* CefContextMenuHandler */
@@ -178,10 +221,6 @@ public:
 					  int sample_rate,
 					  int frames_per_buffer) override;
 #endif
-	/* CefLoadHandler */
-	virtual void OnLoadEnd(CefRefPtr<CefBrowser> browser,
-			       CefRefPtr<CefFrame> frame,
-			       int httpStatusCode) override;
 
 	IMPLEMENT_REFCOUNTING(BrowserClient);
 };
@@ -0,0 +1,123 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+#include <atomic>
+#include "json11/json11.hpp"
+
+/* Log-linear histogram of microsecond values: exact below 16, then 16
+ * sub-buckets per power of two, so every bucket is within ~6% of its
+ * values.  Adding is lock-free and can be done from any thread. */
+
+#define HIST_SUB_BITS 4
+#define HIST_SUB_COUNT (1 << HIST_SUB_BITS)
+#define HIST_MAX_BITS 40
+#define HIST_BUCKETS \
+	(HIST_SUB_COUNT + (HIST_MAX_BITS - HIST_SUB_BITS) * HIST_SUB_COUNT)
+
+class LatencyHistogram {
+	std::atomic<uint64_t> buckets[HIST_BUCKETS];
+
+	static inline int HighBit(uint64_t v)
+	{
+		int bit = 0;
+		while (v >>= 1)
+			bit++;
+		return bit;
+	}
+
+	static inline size_t BucketIndex(uint64_t us)
+	{
+		if (us < HIST_SUB_COUNT)
+			return (size_t)us;
+		if (us >= (1ULL << HIST_MAX_BITS))
+			return HIST_BUCKETS - 1;
+
+		int shift = HighBit(us) - HIST_SUB_BITS;
+		size_t sub = (size_t)(us >> shift) & (HIST_SUB_COUNT - 1);
+		return HIST_SUB_COUNT + (size_t)shift * HIST_SUB_COUNT + sub;
+	}
+
+	/* highest value that lands in bucket |idx| */
+	static inline uint64_t BucketValue(size_t idx)
+	{
+		if (idx < HIST_SUB_COUNT)
+			return idx;
+
+		size_t shift = (idx - HIST_SUB_COUNT) / HIST_SUB_COUNT;
+		uint64_t sub = (idx - HIST_SUB_COUNT) % HIST_SUB_COUNT;
+		return ((HIST_SUB_COUNT + sub + 1) << shift) - 1;
+	}
+
+public:
+	std::atomic<uint64_t> count{0};
+	std::atomic<uint64_t> sum{0};
+	std::atomic<uint64_t> max{0};
+
+	inline LatencyHistogram()
+	{
+		for (auto &bucket : buckets)
+			bucket.store(0, std::memory_order_relaxed);
+	}
+
+	inline void Add(uint64_t us)
+	{
+		buckets[BucketIndex(us)].fetch_add(1,
+						   std::memory_order_relaxed);
+		count.fetch_add(1, std::memory_order_relaxed);
+		sum.fetch_add(us, std::memory_order_relaxed);
+
+		uint64_t cur = max.load(std::memory_order_relaxed);
+		while (us > cur && !max.compare_exchange_weak(cur, us))
+			;
+	}
+
+	inline uint64_t Percentile(double p) const
+	{
+		uint64_t total = count.load(std::memory_order_relaxed);
+		uint64_t target = (uint64_t)((double)total * p + 0.5);
+		uint64_t seen = 0;
+
+		if (!total)
+			return 0;
+		if (!target)
+			target = 1;
+
+		for (size_t i = 0; i < HIST_BUCKETS; i++) {
+			seen += buckets[i].load(std::memory_order_relaxed);
+			if (seen >= target)
+				return std::min(BucketValue(i), max.load());
+		}
+		return max;
+	}
+
+	/* count, mean and percentiles in milliseconds */
+	inline json11::Json ToJson() const
+	{
+		uint64_t n = count;
+		return json11::Json::object{
+			{"count", (double)n},
+			{"mean_ms", n ? (double)(sum / n) / 1000.0 : 0.0},
+			{"p50_ms", (double)Percentile(0.5) / 1000.0},
+			{"p90_ms", (double)Percentile(0.9) / 1000.0},
+			{"p99_ms", (double)Percentile(0.99) / 1000.0},
+			{"max_ms", (double)max / 1000.0},
+		};
+	}
+};
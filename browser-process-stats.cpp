@@ -0,0 +1,74 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "browser-process-stats.hpp"
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <unistd.h>
+
+bool SampleProcess(int pid, ProcessSample &sample)
+{
+	char path[64];
+	char buf[1024];
+	unsigned long long resident;
+	unsigned long long utime, stime;
+	FILE *f;
+
+	if (pid <= 0)
+		return false;
+
+	snprintf(path, sizeof(path), "/proc/%d/statm", pid);
+	f = fopen(path, "r");
+	if (!f)
+		return false;
+
+	bool ok = fscanf(f, "%*u %llu", &resident) == 1;
+	fclose(f);
+	if (!ok)
+		return false;
+
+	snprintf(path, sizeof(path), "/proc/%d/stat", pid);
+	f = fopen(path, "r");
+	if (!f)
+		return false;
+
+	size_t len = fread(buf, 1, sizeof(buf) - 1, f);
+	fclose(f);
+	buf[len] = 0;
+
+	/* the command name can contain spaces, fields are counted from the
+	 * closing parenthesis: state is field 3, utime 14 and stime 15 */
+	const char *fields = strrchr(buf, ')');
+	if (!fields ||
+	    sscanf(fields + 1,
+		   " %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %llu %llu",
+		   &utime, &stime) != 2)
+		return false;
+
+	static const long page_size = sysconf(_SC_PAGESIZE);
+	static const long ticks = sysconf(_SC_CLK_TCK);
+
+	sample.rss = resident * (uint64_t)page_size;
+	sample.cpu_ns = (utime + stime) * 1000000000ULL / (uint64_t)ticks;
+	return true;
+}
+#else
+bool SampleProcess(int, ProcessSample &)
+{
+	return false;
+}
+#endif
@@ -0,0 +1,27 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+
+/* Resource usage of a renderer process.  Only implemented on Linux, where
+ * it's read from /proc; elsewhere sampling always fails. */
+struct ProcessSample {
+	uint64_t rss = 0;    /* bytes */
+	uint64_t cpu_ns = 0; /* user + system time */
+};
+
+extern bool SampleProcess(int pid, ProcessSample &sample);
@@ -0,0 +1,296 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "browser-request-rules.hpp"
+#include "browser-scheme.hpp"
+#include "cef-headers.hpp"
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/util.hpp>
+#include <ctype.h>
+#include <algorithm>
+#include <queue>
+#include <sstream>
+
+static inline std::string ToLower(std::string str)
+{
+	for (char &ch : str)
+		ch = (char)tolower((unsigned char)ch);
+	return str;
+}
+
+static inline std::string Trim(const std::string &str)
+{
+	size_t start = str.find_first_not_of(" \t\r\n");
+	if (start == std::string::npos)
+		return std::string();
+
+	size_t end = str.find_last_not_of(" \t\r\n");
+	return str.substr(start, end - start + 1);
+}
+
+/* ========================================================================= */
+
+RequestRules::RequestRules()
+{
+	host_nodes.emplace_back();
+	match_nodes.emplace_back();
+}
+
+int RequestRules::HostChild(int node, const std::string &label) const
+{
+	for (auto &child : host_nodes[node].children) {
+		if (child.first == label)
+			return child.second;
+	}
+
+	return -1;
+}
+
+int RequestRules::MatchChild(int node, unsigned char ch) const
+{
+	for (auto &child : match_nodes[node].children) {
+		if (child.first == ch)
+			return child.second;
+	}
+
+	return -1;
+}
+
+void RequestRules::AddHostPattern(const std::string &host, int rule)
+{
+	int node = 0;
+	size_t end = host.size();
+
+	/* walk labels right to left so that ||example.com covers
+	 * cdn.example.com as well */
+	while (end > 0) {
+		size_t dot = host.rfind('.', end - 1);
+		size_t start = dot == std::string::npos ? 0 : dot + 1;
+		std::string label = host.substr(start, end - start);
+
+		int child = HostChild(node, label);
+		if (child < 0) {
+			child = (int)host_nodes.size();
+			host_nodes[node].children.emplace_back(label, child);
+			host_nodes.emplace_back();
+		}
+
+		node = child;
+		end = dot == std::string::npos ? 0 : dot;
+	}
+
+	host_nodes[node].rules.push_back(rule);
+}
+
+void RequestRules::AddUrlPattern(const std::string &pattern, int rule)
+{
+	int node = 0;
+
+	for (char ch : pattern) {
+		int child = MatchChild(node, (unsigned char)ch);
+		if (child < 0) {
+			child = (int)match_nodes.size();
+			match_nodes[node].children.emplace_back(
+				(unsigned char)ch, child);
+			match_nodes.emplace_back();
+		}
+
+		node = child;
+	}
+
+	match_nodes[node].rules.push_back(rule);
+}
+
+/* Aho-Corasick failure and output links, built breadth first */
+void RequestRules::BuildMatcher()
+{
+	std::queue<int> queue;
+
+	for (auto &child : match_nodes[0].children) {
+		match_nodes[child.second].fail = 0;
+		queue.push(child.second);
+	}
+
+	while (!queue.empty()) {
+		int node = queue.front();
+		queue.pop();
+
+		for (auto &child : match_nodes[node].children) {
+			unsigned char ch = child.first;
+			int fail = match_nodes[node].fail;
+			int next;
+
+			while ((next = MatchChild(fail, ch)) < 0 && fail != 0)
+				fail = match_nodes[fail].fail;
+
+			MatchNode &target = match_nodes[child.second];
+			target.fail = next >= 0 ? next : 0;
+
+			const MatchNode &fail_node = match_nodes[target.fail];
+			target.output = fail_node.rules.empty()
+						? fail_node.output
+						: target.fail;
+
+			queue.push(child.second);
+		}
+	}
+}
+
+void RequestRules::Match(const std::string &url, const std::string &host,
+			 std::vector<int> &matches) const
+{
+	matches.clear();
+
+	int node = 0;
+	size_t end = host.size();
+
+	while (end > 0) {
+		size_t dot = host.rfind('.', end - 1);
+		size_t start = dot == std::string::npos ? 0 : dot + 1;
+
+		std::string label = ToLower(host.substr(start, end - start));
+
+		node = HostChild(node, label);
+		if (node < 0)
+			break;
+
+		auto &rules = host_nodes[node].rules;
+		matches.insert(matches.end(), rules.begin(), rules.end());
+		end = dot == std::string::npos ? 0 : dot;
+	}
+
+	if (match_nodes.size() > 1) {
+		node = 0;
+
+		for (char raw : url) {
+			unsigned char ch = (unsigned char)tolower(
+				(unsigned char)raw);
+			int next;
+
+			while ((next = MatchChild(node, ch)) < 0 && node != 0)
+				node = match_nodes[node].fail;
+			node = next >= 0 ? next : 0;
+
+			int out = match_nodes[node].rules.empty()
+					  ? match_nodes[node].output
+					  : node;
+
+			while (out >= 0) {
+				auto &rules = match_nodes[out].rules;
+				matches.insert(matches.end(), rules.begin(),
+					       rules.end());
+				out = match_nodes[out].output;
+			}
+		}
+	}
+
+	std::sort(matches.begin(), matches.end());
+	matches.erase(std::unique(matches.begin(), matches.end()),
+		      matches.end());
+}
+
+std::shared_ptr<const RequestRules>
+RequestRules::Compile(const std::string &text)
+{
+	std::shared_ptr<RequestRules> compiled =
+		std::make_shared<RequestRules>();
+	std::istringstream stream(text);
+	std::string line;
+
+	while (std::getline(stream, line)) {
+		line = Trim(line);
+		if (line.empty() || line[0] == '#' || line[0] == '!')
+			continue;
+
+		std::istringstream tokens(line);
+		std::string type;
+		std::string pattern;
+		std::string arg;
+
+		tokens >> type >> pattern;
+		std::getline(tokens, arg);
+		arg = Trim(arg);
+		type = ToLower(type);
+		pattern = ToLower(pattern);
+
+		RequestRule rule;
+
+		if (type == "block" && !pattern.empty()) {
+			rule.type = RequestRuleType::Block;
+
+		} else if (type == "header" && !pattern.empty()) {
+			size_t colon = arg.find(':');
+			if (colon == std::string::npos)
+				goto invalid;
+
+			rule.type = RequestRuleType::Header;
+			rule.name = Trim(arg.substr(0, colon));
+			rule.value = Trim(arg.substr(colon + 1));
+			if (rule.name.empty())
+				goto invalid;
+
+		} else if (type == "redirect" && !pattern.empty() &&
+			   !arg.empty()) {
+			rule.type = RequestRuleType::Redirect;
+			rule.value = LocalFileURL(arg);
+
+		} else {
+			goto invalid;
+		}
+
+		if (pattern.compare(0, 2, "||") == 0) {
+			std::string host = pattern.substr(2);
+			while (!host.empty() &&
+			       (host.back() == '^' || host.back() == '/'))
+				host.pop_back();
+			if (host.empty())
+				goto invalid;
+
+			compiled->AddHostPattern(host,
+						 (int)compiled->rules.size());
+		} else {
+			compiled->AddUrlPattern(pattern,
+						(int)compiled->rules.size());
+		}
+
+		compiled->rules.push_back(std::move(rule));
+		continue;
+
+	invalid:
+		blog(LOG_WARNING, "[obs-browser]: Ignoring request rule: %s",
+		     line.c_str());
+	}
+
+	compiled->BuildMatcher();
+	return compiled;
+}
+
+std::shared_ptr<const RequestRules>
+CompileRequestRules(const std::string &source_rules)
+{
+	BPtr<char> path = obs_module_config_path("request-rules.txt");
+	BPtr<char> global_rules = path ? os_quick_read_utf8_file(path)
+				       : nullptr;
+
+	std::string text;
+	if (global_rules)
+		text = global_rules.Get();
+	text += "\n";
+	text += source_rules;
+
+	std::shared_ptr<const RequestRules> rules = RequestRules::Compile(text);
+	return rules->Empty() ? nullptr : rules;
+}
@@ -0,0 +1,86 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+/* Request rules, one per line:
+ *
+ *   block <pattern>
+ *   header <pattern> <Name>: <value>
+ *   redirect <pattern> <local file>
+ *
+ * A pattern of the form ||example.com matches that host and all of its
+ * subdomains, anything else matches as a case-insensitive substring of the
+ * full URL.  Lines starting with # or ! are comments. */
+
+enum class RequestRuleType {
+	Block,
+	Header,
+	Redirect,
+};
+
+struct RequestRule {
+	RequestRuleType type;
+	std::string name;
+	std::string value;
+};
+
+class RequestRules {
+	struct HostNode {
+		std::vector<std::pair<std::string, int>> children;
+		std::vector<int> rules;
+	};
+
+	struct MatchNode {
+		std::vector<std::pair<unsigned char, int>> children;
+		std::vector<int> rules;
+		int fail = 0;
+		int output = -1;
+	};
+
+	std::vector<RequestRule> rules;
+	std::vector<HostNode> host_nodes;
+	std::vector<MatchNode> match_nodes;
+
+	int HostChild(int node, const std::string &label) const;
+	int MatchChild(int node, unsigned char ch) const;
+
+	void AddHostPattern(const std::string &host, int rule);
+	void AddUrlPattern(const std::string &pattern, int rule);
+	void BuildMatcher();
+
+public:
+	RequestRules();
+
+	inline bool Empty() const { return rules.empty(); }
+
+	/* Returns the indices of all matching rules, sorted in the order they
+	 * were declared */
+	void Match(const std::string &url, const std::string &host,
+		   std::vector<int> &matches) const;
+	inline const RequestRule &Rule(int idx) const { return rules[idx]; }
+
+	static std::shared_ptr<const RequestRules>
+	Compile(const std::string &text);
+};
+
+/* Compiles the global rules in the module config directory
+ * (request-rules.txt) followed by |source_rules| */
+extern std::shared_ptr<const RequestRules>
+CompileRequestRules(const std::string &source_rules);
@@ -18,9 +18,531 @@
 
 #include "browser-scheme.hpp"
 #include "wide-string.hpp"
+#include <util/platform.h>
+#include <sys/stat.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdio.h>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#if !ENABLE_LOCAL_FILE_URL_SCHEME
 #include <include/wrapper/cef_stream_resource_handler.h>
+#endif
+
+std::string LocalFileURL(const std::string &path)
+{
+	std::string url = CefURIEncode(path, false);
+
+#ifdef _WIN32
+	size_t slash = url.find("%2F");
+	size_t colon = url.find("%3A");
+
+	if (slash != std::string::npos && colon != std::string::npos &&
+	    colon < slash)
+		url.replace(colon, 3, ":");
+#endif
+
+	while (url.find("%5C") != std::string::npos)
+		url.replace(url.find("%5C"), 3, "/");
+
+	while (url.find("%2F") != std::string::npos)
+		url.replace(url.find("%2F"), 3, "/");
 
 #if !ENABLE_LOCAL_FILE_URL_SCHEME
+	/* http://absolute/ based mapping for older CEF */
+	return "http://absolute/" + url;
+#elif defined(_WIN32)
+	/* Widows-style local file URL:
+	 * file:///C:/file/path.webm */
+	return "file:///" + url;
+#else
+	/* UNIX-style local file URL:
+	 * file:///home/user/file.webm */
+	return "file://" + url;
+#endif
+}
+
+int64_t GetFileMTime(const std::string &path, const struct stat &st)
+{
+#if defined(_WIN32)
+	/* the CRT's stat only keeps whole seconds, the file system keeps
+	 * 100 ns intervals since 1601 */
+	WIN32_FILE_ATTRIBUTE_DATA attr;
+	if (GetFileAttributesExW(to_wide(path).c_str(), GetFileExInfoStandard,
+				 &attr)) {
+		const int64_t epoch_offset = 116444736000000000LL;
+		ULARGE_INTEGER time;
+		time.LowPart = attr.ftLastWriteTime.dwLowDateTime;
+		time.HighPart = attr.ftLastWriteTime.dwHighDateTime;
+		return ((int64_t)time.QuadPart - epoch_offset) * 100;
+	}
+
+	return (int64_t)st.st_mtime * 1000000000LL;
+#elif defined(__APPLE__)
+	(void)path;
+	return (int64_t)st.st_mtimespec.tv_sec * 1000000000LL +
+	       (int64_t)st.st_mtimespec.tv_nsec;
+#else
+	(void)path;
+	return (int64_t)st.st_mtim.tv_sec * 1000000000LL +
+	       (int64_t)st.st_mtim.tv_nsec;
+#endif
+}
+
+#if !ENABLE_LOCAL_FILE_URL_SCHEME
+/* ========================================================================= */
+/* Local overlays tend to request the same sprites, fonts and JSON files on
+ * every refresh, so small files are kept in memory and shared between all
+ * browsers.  Entries are validated against the file's size and mtime. */
+
+#define FILE_CACHE_MAX_BYTES (64 * 1024 * 1024)
+#define FILE_CACHE_MAX_FILE_BYTES (4 * 1024 * 1024)
+
+typedef std::shared_ptr<const std::vector<char>> FileData;
+
+struct CachedFile {
+	std::string path;
+	std::string mime_type;
+	FileData data;
+	int64_t size;
+	int64_t mtime; /* ns */
+};
+
+typedef std::list<CachedFile> FileCacheList;
+
+static std::mutex file_cache_mutex;
+static FileCacheList file_cache;
+static std::unordered_map<std::string, FileCacheList::iterator> file_cache_map;
+static size_t file_cache_bytes = 0;
+
+static void EraseCachedFile(FileCacheList::iterator entry)
+{
+	file_cache_bytes -= entry->data->size();
+	file_cache_map.erase(entry->path);
+	file_cache.erase(entry);
+}
+
+static FileData LookupCachedFile(const std::string &path,
+				 const struct stat &st, std::string &mime_type)
+{
+	std::lock_guard<std::mutex> lock(file_cache_mutex);
+
+	auto it = file_cache_map.find(path);
+	if (it == file_cache_map.end())
+		return nullptr;
+
+	FileCacheList::iterator entry = it->second;
+	if (entry->size != (int64_t)st.st_size ||
+	    entry->mtime != GetFileMTime(path, st)) {
+		EraseCachedFile(entry);
+		return nullptr;
+	}
+
+	file_cache.splice(file_cache.begin(), file_cache, entry);
+	mime_type = entry->mime_type;
+	return entry->data;
+}
+
+static void StoreCachedFile(const std::string &path, const struct stat &st,
+			    const std::string &mime_type, FileData data)
+{
+	std::lock_guard<std::mutex> lock(file_cache_mutex);
+
+	auto it = file_cache_map.find(path);
+	if (it != file_cache_map.end())
+		EraseCachedFile(it->second);
+
+	file_cache.push_front({path, mime_type, data, (int64_t)st.st_size,
+			       GetFileMTime(path, st)});
+	file_cache_map[path] = file_cache.begin();
+	file_cache_bytes += data->size();
+
+	while (file_cache_bytes > FILE_CACHE_MAX_BYTES)
+		EraseCachedFile(std::prev(file_cache.end()));
+}
+
+static FileData ReadFileData(const std::string &path, size_t size)
+{
+#ifdef _WIN32
+	FILE *file = _wfopen(to_wide(path).c_str(), L"rb");
+#else
+	FILE *file = fopen(path.c_str(), "rb");
+#endif
+	if (!file)
+		return nullptr;
+
+	auto data = std::make_shared<std::vector<char>>(size);
+	size_t read = size ? fread(data->data(), 1, size, file) : 0;
+	fclose(file);
+
+	if (read != size)
+		return nullptr;
+
+	return data;
+}
+
+/* ========================================================================= */
+/* Files too large for the cache (typically local video/audio) and asset
+ * bundles are streamed with positional reads, which also makes seeking with
+ * byte-range requests cheap.  They aren't mapped: overlay files get
+ * rewritten while OBS runs, and touching a mapping of a file that has been
+ * truncated raises SIGBUS. */
+
+FileReader::~FileReader()
+{
+#ifdef _WIN32
+	if (handle != INVALID_HANDLE_VALUE)
+		CloseHandle(handle);
+#else
+	if (fd != -1)
+		close(fd);
+#endif
+}
+
+std::shared_ptr<FileReader> FileReader::Open(const std::string &path)
+{
+	std::shared_ptr<FileReader> file(new FileReader());
+
+#ifdef _WIN32
+	file->handle = CreateFileW(to_wide(path).c_str(), GENERIC_READ,
+				   FILE_SHARE_READ | FILE_SHARE_WRITE |
+					   FILE_SHARE_DELETE,
+				   nullptr, OPEN_EXISTING,
+				   FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file->handle == INVALID_HANDLE_VALUE)
+		return nullptr;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file->handle, &size))
+		return nullptr;
+	file->size = (uint64_t)size.QuadPart;
+#else
+	file->fd = open(path.c_str(), O_RDONLY);
+	if (file->fd == -1)
+		return nullptr;
+
+	struct stat st;
+	if (fstat(file->fd, &st) != 0)
+		return nullptr;
+	file->size = (uint64_t)st.st_size;
+#endif
+
+	if (file->size > (uint64_t)SIZE_MAX)
+		return nullptr;
+	return file;
+}
+
+size_t FileReader::Read(void *data, size_t count, uint64_t offset) const
+{
+#ifdef _WIN32
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = (DWORD)offset;
+	overlapped.OffsetHigh = (DWORD)(offset >> 32);
+
+	DWORD read = 0;
+	if (count > MAXDWORD)
+		count = MAXDWORD;
+	if (!ReadFile(handle, data, (DWORD)count, &read, &overlapped))
+		return 0;
+	return (size_t)read;
+#else
+	ssize_t read;
+	do {
+		read = pread(fd, data, count, (off_t)offset);
+	} while (read == -1 && errno == EINTR);
+	return read > 0 ? (size_t)read : 0;
+#endif
+}
+
+/* ========================================================================= */
+
+enum class ByteRange {
+	Invalid,
+	Satisfiable,
+	Unsatisfiable,
+};
+
+static bool ParseRangeNumber(const std::string &str, size_t &val)
+{
+	if (str.empty() || str.size() > 19)
+		return false;
+
+	uint64_t num = 0;
+	for (char ch : str) {
+		if (ch < '0' || ch > '9')
+			return false;
+		num = num * 10 + (uint64_t)(ch - '0');
+	}
+
+	val = num > (uint64_t)SIZE_MAX ? SIZE_MAX : (size_t)num;
+	return true;
+}
+
+/* Parses a single "bytes=" range, end is exclusive.  A header that isn't a
+ * valid range is Invalid and gets ignored, a valid range outside the file
+ * is Unsatisfiable (RFC 7233) */
+static ByteRange ParseByteRange(const std::string &header, size_t size,
+				size_t &start, size_t &end)
+{
+	if (header.compare(0, 6, "bytes=") != 0)
+		return ByteRange::Invalid;
+
+	std::string range = header.substr(6);
+	size_t dash = range.find('-');
+	if (dash == std::string::npos)
+		return ByteRange::Invalid;
+
+	std::string first = range.substr(0, dash);
+	std::string last = range.substr(dash + 1);
+	size_t first_val = 0;
+	size_t last_val = 0;
+
+	if (first.empty()) {
+		/* suffix range, the last N bytes */
+		if (!ParseRangeNumber(last, last_val))
+			return ByteRange::Invalid;
+		if (!last_val || !size)
+			return ByteRange::Unsatisfiable;
+
+		start = size > last_val ? size - last_val : 0;
+		end = size;
+		return ByteRange::Satisfiable;
+	}
+
+	if (!ParseRangeNumber(first, first_val))
+		return ByteRange::Invalid;
+	if (!last.empty() &&
+	    (!ParseRangeNumber(last, last_val) || last_val < first_val))
+		return ByteRange::Invalid;
+	if (first_val >= size)
+		return ByteRange::Unsatisfiable;
+
+	start = first_val;
+	end = last.empty() || last_val >= size - 1 ? size : last_val + 1;
+	return ByteRange::Satisfiable;
+}
+
+/* Serves |size| bytes of a resource with Range support, subclasses read
+ * the actual bytes */
+class RangeResourceHandler : public CefResourceHandler {
+	size_t size;
+	std::string mime_type;
+	CefResponse::HeaderMap extra_headers;
+
+	int status = 200;
+	size_t start = 0;
+	size_t end = 0;
+	size_t offset = 0;
+
+protected:
+	/* Returns the number of bytes read, 0 if the data is gone */
+	virtual size_t ReadAt(void *data_out, size_t count,
+			      size_t offset) = 0;
+
+public:
+	inline RangeResourceHandler(size_t size_,
+				    const std::string &mime_type_,
+				    const CefResponse::HeaderMap &extra_headers_)
+		: size(size_),
+		  mime_type(mime_type_),
+		  extra_headers(extra_headers_)
+	{
+	}
+
+	virtual bool Open(CefRefPtr<CefRequest> request, bool &handle_request,
+			  CefRefPtr<CefCallback>) override
+	{
+		handle_request = true;
+
+		start = 0;
+		end = size;
+
+		/* multi-range requests are answered with the whole file, and
+		 * so are ranges that can't be parsed */
+		std::string range = request->GetHeaderByName("Range");
+		if (!range.empty() && range.find(',') == std::string::npos) {
+			switch (ParseByteRange(range, size, start, end)) {
+			case ByteRange::Invalid:
+				start = 0;
+				end = size;
+				break;
+			case ByteRange::Satisfiable:
+				status = 206;
+				break;
+			case ByteRange::Unsatisfiable:
+				status = 416;
+				break;
+			}
+		}
+
+		offset = start;
+		return true;
+	}
+
+	virtual void GetResponseHeaders(CefRefPtr<CefResponse> response,
+					int64 &response_length,
+					CefString &) override
+	{
+		CefResponse::HeaderMap headers = extra_headers;
+		headers.insert(std::make_pair("Accept-Ranges", "bytes"));
+
+		if (status == 206) {
+			std::string content_range =
+				"bytes " + std::to_string(start) + "-" +
+				std::to_string(end - 1) + "/" +
+				std::to_string(size);
+			headers.insert(
+				std::make_pair("Content-Range", content_range));
+		} else if (status == 416) {
+			headers.insert(std::make_pair(
+				"Content-Range",
+				"bytes */" + std::to_string(size)));
+		}
+
+		response->SetHeaderMap(headers);
+		response->SetMimeType(mime_type);
+		response->SetStatus(status);
+
+		response_length = status == 416 ? 0 : (int64)(end - start);
+	}
+
+	virtual bool Skip(int64 bytes_to_skip, int64 &bytes_skipped,
+			  CefRefPtr<CefResourceSkipCallback>) override
+	{
+		size_t skip = std::min((size_t)bytes_to_skip, end - offset);
+		if (!skip) {
+			bytes_skipped = -2; /* ERR_FAILED */
+			return false;
+		}
+
+		offset += skip;
+		bytes_skipped = (int64)skip;
+		return true;
+	}
+
+	virtual bool Read(void *data_out, int bytes_to_read, int &bytes_read,
+			  CefRefPtr<CefResourceReadCallback>) override
+	{
+		size_t count = std::min((size_t)bytes_to_read, end - offset);
+		if (status == 416 || !count) {
+			bytes_read = 0;
+			return false;
+		}
+
+		/* a file that shrank while being served ends the response,
+		 * which CEF reports as a truncated body */
+		count = ReadAt(data_out, count, offset);
+		if (!count) {
+			bytes_read = 0;
+			return false;
+		}
+
+		offset += count;
+		bytes_read = (int)count;
+		return true;
+	}
+
+	virtual void Cancel() override {}
+};
+
+/* Serves a resource from memory (cache entry or mapping) */
+class MemoryResourceHandler : public RangeResourceHandler {
+	std::shared_ptr<const void> owner;
+	const char *data;
+
+protected:
+	virtual size_t ReadAt(void *data_out, size_t count,
+			      size_t offset) override
+	{
+		memcpy(data_out, data + offset, count);
+		return count;
+	}
+
+public:
+	inline MemoryResourceHandler(std::shared_ptr<const void> owner_,
+				     const char *data_, size_t size_,
+				     const std::string &mime_type_,
+				     const CefResponse::HeaderMap &extra_headers_)
+		: RangeResourceHandler(size_, mime_type_, extra_headers_),
+		  owner(owner_),
+		  data(data_)
+	{
+	}
+
+	IMPLEMENT_REFCOUNTING(MemoryResourceHandler);
+};
+
+/* Serves a resource straight from a file with positional reads */
+class FileResourceHandler : public RangeResourceHandler {
+	std::shared_ptr<const FileReader> file;
+	uint64_t base;
+
+protected:
+	virtual size_t ReadAt(void *data_out, size_t count,
+			      size_t offset) override
+	{
+		return file->Read(data_out, count, base + offset);
+	}
+
+public:
+	inline FileResourceHandler(std::shared_ptr<const FileReader> file_,
+				   uint64_t base_, size_t size_,
+				   const std::string &mime_type_,
+				   const CefResponse::HeaderMap &extra_headers_)
+		: RangeResourceHandler(size_, mime_type_, extra_headers_),
+		  file(file_),
+		  base(base_)
+	{
+	}
+
+	IMPLEMENT_REFCOUNTING(FileResourceHandler);
+};
+
+CefRefPtr<CefResourceHandler>
+CreateMemoryResourceHandler(std::shared_ptr<const void> owner,
+			    const char *data, size_t size,
+			    const std::string &mime_type,
+			    const CefResponse::HeaderMap &headers)
+{
+	return new MemoryResourceHandler(owner, data, size, mime_type,
+					 headers);
+}
+
+CefRefPtr<CefResourceHandler>
+CreateFileResourceHandler(std::shared_ptr<const FileReader> file,
+			  uint64_t offset, size_t size,
+			  const std::string &mime_type,
+			  const CefResponse::HeaderMap &headers)
+{
+	return new FileResourceHandler(file, offset, size, mime_type, headers);
+}
+
+std::string GetFileMimeType(const std::string &path)
+{
+	std::string fileExtension = path.substr(path.find_last_of(".") + 1);
+
+	for (char &ch : fileExtension)
+		ch = (char)tolower(ch);
+	if (fileExtension.compare("woff2") == 0)
+		fileExtension = "woff";
+
+	return CefGetMimeType(fileExtension);
+}
+
+/* ========================================================================= */
+
 CefRefPtr<CefResourceHandler>
 BrowserSchemeHandlerFactory::Create(CefRefPtr<CefBrowser> browser,
 				    CefRefPtr<CefFrame>, const CefString &,
@@ -40,24 +562,40 @@ BrowserSchemeHandlerFactory::Create(CefRefPtr<CefBrowser> browser,
 		cef_uri_unescape_rule_t::
 			UU_URL_SPECIAL_CHARS_EXCEPT_PATH_SEPARATORS);
 
-	std::string fileExtension = path.substr(path.find_last_of(".") + 1);
+#ifdef _WIN32
+	path = path.substr(1);
+#endif
 
-	for (char &ch : fileExtension)
-		ch = (char)tolower(ch);
-	if (fileExtension.compare("woff2") == 0)
-		fileExtension = "woff";
+	struct stat st;
+	if (os_stat(path.c_str(), &st) != 0)
+		return nullptr;
+
+	std::string mime_type;
+	FileData data = LookupCachedFile(path, st, mime_type);
+
+	if (!data && st.st_size <= FILE_CACHE_MAX_FILE_BYTES) {
+		data = ReadFileData(path, (size_t)st.st_size);
+		if (data) {
+			mime_type = GetFileMimeType(path);
+			StoreCachedFile(path, st, mime_type, data);
+		}
+	}
+
+	if (data)
+		return CreateMemoryResourceHandler(data, data->data(),
+						   data->size(), mime_type);
+
+	std::shared_ptr<FileReader> file = FileReader::Open(path);
+	if (file)
+		return CreateFileResourceHandler(file, 0, (size_t)file->size,
+						 GetFileMimeType(path));
 
-#ifdef _WIN32
-	CefRefPtr<CefStreamReader> stream =
-		CefStreamReader::CreateForFile(path.substr(1));
-#else
 	CefRefPtr<CefStreamReader> stream =
 		CefStreamReader::CreateForFile(path);
-#endif
 
 	if (stream) {
-		return new CefStreamResourceHandler(
-			CefGetMimeType(fileExtension), stream);
+		return new CefStreamResourceHandler(GetFileMimeType(path),
+						    stream);
 	} else {
 		return nullptr;
 	}
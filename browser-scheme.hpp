@@ -19,8 +19,11 @@
 #pragma once
 
 #include "cef-headers.hpp"
+#include <sys/stat.h>
+#include <stdint.h>
 #include <string>
 #include <fstream>
+#include <memory>
 
 #if CHROME_VERSION_BUILD < 4638
 #define ENABLE_LOCAL_FILE_URL_SCHEME 1
@@ -28,6 +31,15 @@
 #define ENABLE_LOCAL_FILE_URL_SCHEME 0
 #endif
 
+/* Maps a local file path to the URL browsers load it from, file:// or
+ * http://absolute/ depending on the CEF version */
+extern std::string LocalFileURL(const std::string &path);
+
+/* Modification time of the file at |path| that |st| was read from, in
+ * nanoseconds since the epoch and as precise as the file system keeps it.
+ * Seconds alone miss a file saved twice within the same second. */
+extern int64_t GetFileMTime(const std::string &path, const struct stat &st);
+
 #if !ENABLE_LOCAL_FILE_URL_SCHEME
 class BrowserSchemeHandlerFactory : public CefSchemeHandlerFactory {
 public:
@@ -37,4 +49,40 @@ public:
 
 	IMPLEMENT_REFCOUNTING(BrowserSchemeHandlerFactory);
 };
+
+/* A file read with positional reads, see browser-scheme.cpp */
+class FileReader {
+	FileReader() = default;
+
+#ifdef _WIN32
+	void *handle = (void *)(intptr_t)-1;
+#else
+	int fd = -1;
+#endif
+
+public:
+	uint64_t size = 0;
+
+	~FileReader();
+
+	static std::shared_ptr<FileReader> Open(const std::string &path);
+
+	/* Returns the number of bytes read, 0 past the end of the file or on
+	 * errors */
+	size_t Read(void *data, size_t count, uint64_t offset) const;
+};
+
+extern std::string GetFileMimeType(const std::string &path);
+
+/* Serves |data| (kept alive by |owner|) with byte-range support */
+extern CefRefPtr<CefResourceHandler> CreateMemoryResourceHandler(
+	std::shared_ptr<const void> owner, const char *data, size_t size,
+	const std::string &mime_type,
+	const CefResponse::HeaderMap &headers = CefResponse::HeaderMap());
+
+/* Serves |size| bytes of |file| from |offset| with byte-range support */
+extern CefRefPtr<CefResourceHandler> CreateFileResourceHandler(
+	std::shared_ptr<const FileReader> file, uint64_t offset, size_t size,
+	const std::string &mime_type,
+	const CefResponse::HeaderMap &headers = CefResponse::HeaderMap());
 #endif
@@ -0,0 +1,183 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "browser-task-monitor.hpp"
+#include "browser-histogram.hpp"
+#include "json11/json11.hpp"
+#include <obs-module.h>
+#include <util/threading.h>
+#include <util/platform.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <atomic>
+#include <thread>
+
+using namespace json11;
+
+/* tasks running longer than this are reported while they still run */
+#define TASK_WATCHDOG_THRESHOLD_MS 500
+#define TASK_WATCHDOG_INTERVAL_MS 100
+
+/* ========================================================================= */
+
+struct TaskStats {
+	LatencyHistogram queue_delay;
+	LatencyHistogram run_time;
+};
+
+static TaskStats task_stats[(int)TaskCategory::Count];
+
+static const char *CategoryName(TaskCategory category)
+{
+	switch (category) {
+	case TaskCategory::Input:
+		return "input";
+	case TaskCategory::Create:
+		return "create";
+	case TaskCategory::Visibility:
+		return "visibility";
+	case TaskCategory::JSEvent:
+		return "js_event";
+	default:
+		return "other";
+	}
+}
+
+/* ========================================================================= */
+
+static std::atomic<int> running_category{(int)TaskCategory::Other};
+static std::atomic<uint64_t> running_start{0};
+
+TaskMonitorScope::TaskMonitorScope(TaskCategory category_, uint64_t queued_ts_)
+	: category(category_), queued_ts(queued_ts_), start(os_gettime_ns())
+{
+	/* tasks can nest when a task spins the Qt event loop */
+	prev_category = (TaskCategory)running_category.load();
+	prev_start = running_start.load();
+
+	running_category = (int)category;
+	running_start = start;
+}
+
+TaskMonitorScope::~TaskMonitorScope()
+{
+	uint64_t end = os_gettime_ns();
+	TaskStats &stats = task_stats[(int)category];
+
+	running_category = (int)prev_category;
+	running_start = prev_start;
+
+	stats.queue_delay.Add((start - queued_ts) / 1000);
+	stats.run_time.Add((end - start) / 1000);
+
+	if (end - start >= TASK_WATCHDOG_THRESHOLD_MS * 1000000ULL)
+		blog(LOG_WARNING,
+		     "[obs-browser]: '%s' task blocked the CEF UI thread "
+		     "for %" PRIu64 " ms",
+		     CategoryName(category), (end - start) / 1000000);
+}
+
+/* ========================================================================= */
+
+static std::thread watchdog_thread;
+static os_event_t *watchdog_stop = nullptr;
+
+static void TaskWatchdog()
+{
+	uint64_t reported = 0;
+
+	os_set_thread_name("obs-browser: task watchdog");
+
+	while (os_event_timedwait(watchdog_stop, TASK_WATCHDOG_INTERVAL_MS) ==
+	       ETIMEDOUT) {
+		uint64_t start = running_start;
+		if (!start || start == reported)
+			continue;
+
+		uint64_t ms = (os_gettime_ns() - start) / 1000000;
+		if (ms < TASK_WATCHDOG_THRESHOLD_MS)
+			continue;
+
+		TaskCategory category = (TaskCategory)running_category.load();
+		blog(LOG_WARNING,
+		     "[obs-browser]: CEF UI thread has been blocked by a '%s' "
+		     "task for %" PRIu64 " ms",
+		     CategoryName(category), ms);
+		reported = start;
+	}
+}
+
+void TaskMonitorStart()
+{
+	if (watchdog_thread.joinable())
+		return;
+
+	os_event_init(&watchdog_stop, OS_EVENT_TYPE_MANUAL);
+	watchdog_thread = std::thread(TaskWatchdog);
+}
+
+void TaskMonitorStop()
+{
+	if (!watchdog_thread.joinable())
+		return;
+
+	os_event_signal(watchdog_stop);
+	watchdog_thread.join();
+	os_event_destroy(watchdog_stop);
+	watchdog_stop = nullptr;
+}
+
+static inline double ToMs(uint64_t us)
+{
+	return (double)us / 1000.0;
+}
+
+std::string TaskMonitorJson()
+{
+	Json::object json;
+
+	for (int i = 0; i < (int)TaskCategory::Count; i++) {
+		const TaskStats &stats = task_stats[i];
+		json[CategoryName((TaskCategory)i)] = Json::object{
+			{"queue_delay", stats.queue_delay.ToJson()},
+			{"run_time", stats.run_time.ToJson()},
+		};
+	}
+
+	return Json(json).dump();
+}
+
+void TaskMonitorLog()
+{
+	blog(LOG_INFO, "[obs-browser]: CEF UI thread tasks "
+		       "(queue delay / run time, ms):");
+
+	for (int i = 0; i < (int)TaskCategory::Count; i++) {
+		const TaskStats &stats = task_stats[i];
+		const LatencyHistogram &queue = stats.queue_delay;
+		const LatencyHistogram &run = stats.run_time;
+
+		if (!run.count)
+			continue;
+
+		blog(LOG_INFO,
+		     "[obs-browser]:   %-10s %8" PRIu64 " tasks, "
+		     "p50 %.2f / %.2f, p99 %.2f / %.2f, max %.2f / %.2f",
+		     CategoryName((TaskCategory)i), (uint64_t)run.count,
+		     ToMs(queue.Percentile(0.5)), ToMs(run.Percentile(0.5)),
+		     ToMs(queue.Percentile(0.99)), ToMs(run.Percentile(0.99)),
+		     ToMs(queue.max), ToMs(run.max));
+	}
+}
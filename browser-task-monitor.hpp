@@ -0,0 +1,54 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <stdint.h>
+#include <functional>
+#include <string>
+
+/* Queue delay and run time of every task run on the CEF UI thread, kept per
+ * category, plus a watchdog that reports tasks blocking the thread. */
+
+enum class TaskCategory {
+	Other,
+	Input,
+	Create,
+	Visibility,
+	JSEvent,
+	Count,
+};
+
+extern bool QueueCEFTask(std::function<void()> task,
+			 TaskCategory category = TaskCategory::Other);
+
+/* Wraps the execution of a task queued at |queued_ts| */
+class TaskMonitorScope {
+	TaskCategory category;
+	uint64_t queued_ts;
+	uint64_t start;
+
+	TaskCategory prev_category;
+	uint64_t prev_start;
+
+public:
+	TaskMonitorScope(TaskCategory category, uint64_t queued_ts);
+	~TaskMonitorScope();
+};
+
+extern void TaskMonitorStart();
+extern void TaskMonitorStop();
+extern void TaskMonitorLog();
+extern std::string TaskMonitorJson();
@@ -0,0 +1,251 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "browser-trace.hpp"
+#include <obs-module.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#define TRACE_BUFFER_SIZE 16384
+
+enum class TracePhase : char {
+	Complete = 'X',
+	FlowStart = 's',
+	FlowEnd = 'f',
+};
+
+struct TraceEvent {
+	const char *name;
+	uint64_t ts;
+	uint64_t dur;
+	uint64_t id;
+	TracePhase phase;
+};
+
+/* A ring slot.  |seq| is the event's position in the ring plus one, and 0
+ * while the writer is filling the slot in. */
+struct TraceSlot {
+	std::atomic<uint64_t> seq{0};
+	TraceEvent event;
+};
+
+/* Written only by its own thread.  The dumping thread copies the ring and
+ * drops every slot whose sequence number changed under it, so neither side
+ * ever blocks. */
+struct TraceBuffer {
+	TraceSlot slots[TRACE_BUFFER_SIZE];
+	std::atomic<uint64_t> head{0};
+	std::atomic<const char *> name{nullptr};
+	uint32_t tid = 0;
+};
+
+std::atomic<bool> trace_enabled{false};
+
+static std::atomic<uint64_t> trace_start_ts{0};
+static std::atomic<uint64_t> trace_flow_id{0};
+static std::mutex trace_buffers_mutex;
+static std::vector<std::unique_ptr<TraceBuffer>> trace_buffers;
+static thread_local TraceBuffer *trace_buffer = nullptr;
+
+/* buffers outlive their threads, events of exited threads are still dumped */
+static TraceBuffer *GetTraceBuffer()
+{
+	if (!trace_buffer) {
+		std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+		trace_buffers.emplace_back(new TraceBuffer);
+		trace_buffer = trace_buffers.back().get();
+		trace_buffer->tid = (uint32_t)trace_buffers.size();
+	}
+
+	return trace_buffer;
+}
+
+static void TraceRecord(const char *name, TracePhase phase, uint64_t ts,
+			uint64_t dur, uint64_t id)
+{
+	TraceBuffer *buf = GetTraceBuffer();
+	uint64_t head = buf->head.load(std::memory_order_relaxed);
+	TraceSlot &slot = buf->slots[head % TRACE_BUFFER_SIZE];
+
+	slot.seq.store(0, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.event.name = name;
+	slot.event.ts = ts;
+	slot.event.dur = dur;
+	slot.event.id = id;
+	slot.event.phase = phase;
+
+	slot.seq.store(head + 1, std::memory_order_release);
+	buf->head.store(head + 1, std::memory_order_release);
+}
+
+/* the rings are never reset, events from before the last start are skipped
+ * when dumping instead */
+void TraceStart()
+{
+	trace_start_ts = os_gettime_ns();
+	trace_enabled = true;
+	blog(LOG_INFO, "[obs-browser]: Tracing started");
+}
+
+void TraceStop()
+{
+	trace_enabled = false;
+}
+
+void TraceThreadName(const char *name)
+{
+	if (!TraceEnabled())
+		return;
+
+	TraceBuffer *buf = GetTraceBuffer();
+	if (!buf->name.load(std::memory_order_relaxed))
+		buf->name.store(name, std::memory_order_relaxed);
+}
+
+void TraceComplete(const char *name, uint64_t start, uint64_t end)
+{
+	TraceRecord(name, TracePhase::Complete, start, end - start, 0);
+}
+
+uint64_t TraceFlowStart(const char *name)
+{
+	if (!TraceEnabled())
+		return 0;
+
+	uint64_t id = ++trace_flow_id;
+	TraceRecord(name, TracePhase::FlowStart, os_gettime_ns(), 0, id);
+	return id;
+}
+
+void TraceFlowEnd(const char *name, uint64_t id)
+{
+	if (id && TraceEnabled())
+		TraceRecord(name, TracePhase::FlowEnd, os_gettime_ns(), 0, id);
+}
+
+static void CopyEvents(TraceBuffer *buf, std::vector<TraceEvent> &events)
+{
+	/* the oldest slot is the one the writer fills next, skip it */
+	uint64_t end = buf->head.load(std::memory_order_acquire);
+	uint64_t start = end >= TRACE_BUFFER_SIZE ? end - TRACE_BUFFER_SIZE + 1
+						  : 0;
+
+	events.clear();
+	events.reserve((size_t)(end - start));
+
+	for (uint64_t i = start; i < end; i++) {
+		const TraceSlot &slot = buf->slots[i % TRACE_BUFFER_SIZE];
+
+		/* a slot reused while it was being copied may be torn */
+		if (slot.seq.load(std::memory_order_acquire) != i + 1)
+			continue;
+		TraceEvent event = slot.event;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.seq.load(std::memory_order_relaxed) != i + 1)
+			continue;
+
+		events.push_back(event);
+	}
+}
+
+static inline double ToMicroseconds(uint64_t ns)
+{
+	return (double)ns / 1000.0;
+}
+
+struct TraceThread {
+	uint32_t tid;
+	const char *name;
+	std::vector<TraceEvent> events;
+};
+
+bool TraceDump(const char *path)
+{
+	std::vector<TraceThread> threads;
+	uint64_t start_ts = trace_start_ts;
+
+	/* only the copy needs the lock, writing the file can take a while */
+	{
+		std::lock_guard<std::mutex> lock(trace_buffers_mutex);
+		threads.resize(trace_buffers.size());
+
+		for (size_t i = 0; i < trace_buffers.size(); i++) {
+			TraceBuffer *buf = trace_buffers[i].get();
+			threads[i].tid = buf->tid;
+			threads[i].name =
+				buf->name.load(std::memory_order_relaxed);
+			CopyEvents(buf, threads[i].events);
+		}
+	}
+
+	FILE *f = os_fopen(path, "wb");
+	if (!f) {
+		blog(LOG_WARNING,
+		     "[obs-browser]: Failed to open trace file '%s'", path);
+		return false;
+	}
+
+	bool first = true;
+
+	fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+
+	for (const TraceThread &thread : threads) {
+		if (thread.name) {
+			fprintf(f,
+				"%s{\"ph\":\"M\",\"name\":\"thread_name\","
+				"\"pid\":1,\"tid\":%" PRIu32 ","
+				"\"args\":{\"name\":\"%s\"}}",
+				first ? "" : ",\n", thread.tid, thread.name);
+			first = false;
+		}
+
+		for (const TraceEvent &event : thread.events) {
+			if (event.ts < start_ts)
+				continue;
+
+			fprintf(f,
+				"%s{\"ph\":\"%c\",\"name\":\"%s\","
+				"\"cat\":\"obs-browser\",\"pid\":1,"
+				"\"tid\":%" PRIu32 ",\"ts\":%.3f",
+				first ? "" : ",\n", (char)event.phase,
+				event.name, thread.tid,
+				ToMicroseconds(event.ts));
+			first = false;
+
+			if (event.phase == TracePhase::Complete)
+				fprintf(f, ",\"dur\":%.3f",
+					ToMicroseconds(event.dur));
+			else
+				fprintf(f, ",\"id\":%" PRIu64, event.id);
+
+			if (event.phase == TracePhase::FlowEnd)
+				fprintf(f, ",\"bp\":\"e\"");
+
+			fprintf(f, "}");
+		}
+	}
+
+	fprintf(f, "\n]}\n");
+	fclose(f);
+
+	blog(LOG_INFO, "[obs-browser]: Trace written to '%s'", path);
+	return true;
+}
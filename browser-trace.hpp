@@ -0,0 +1,62 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#pragma once
+
+#include <util/platform.h>
+#include <stdint.h>
+#include <atomic>
+
+/* Optional span tracing of the CEF/OBS boundary.  Each thread records into
+ * its own ring buffer without locking; TraceDump writes everything recorded
+ * as Chrome trace event JSON, for chrome://tracing or Perfetto. */
+
+extern std::atomic<bool> trace_enabled;
+
+extern void TraceStart();
+extern void TraceStop();
+extern bool TraceDump(const char *path);
+
+extern void TraceThreadName(const char *name);
+extern void TraceComplete(const char *name, uint64_t start, uint64_t end);
+extern uint64_t TraceFlowStart(const char *name);
+extern void TraceFlowEnd(const char *name, uint64_t id);
+
+static inline bool TraceEnabled()
+{
+	return trace_enabled.load(std::memory_order_relaxed);
+}
+
+class TraceScope {
+	const char *name;
+	uint64_t start;
+
+public:
+	inline TraceScope(const char *name_)
+		: name(name_), start(TraceEnabled() ? os_gettime_ns() : 0)
+	{
+	}
+
+	inline ~TraceScope()
+	{
+		if (start)
+			TraceComplete(name, start, os_gettime_ns());
+	}
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) \
+	TraceScope TRACE_CONCAT(trace_scope_, __LINE__)(name)
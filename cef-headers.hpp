@@ -27,6 +27,11 @@
 #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
 #endif
 
+#ifdef BROWSER_MOCK_CEF
+/* obs-browser-microbench builds the plugin against a mock of the part of
+ * the CEF API it uses instead, see obs-browser-microbench/mock-cef.hpp */
+#include "obs-browser-microbench/mock-cef.hpp"
+#else
 #include <include/cef_app.h>
 #include <include/cef_base.h>
 #include <include/cef_task.h>
@@ -40,6 +45,7 @@
 #if defined(__APPLE__) && !defined(BROWSER_LEGACY)
 #include "include/wrapper/cef_library_loader.h"
 #endif
+#endif
 
 #if CHROME_VERSION_BUILD >= 4430
 #define ENABLE_WASHIDDEN 1
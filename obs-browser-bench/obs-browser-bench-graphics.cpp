@@ -0,0 +1,264 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/* Stub graphics backend for obs-browser-bench and obs-browser-microbench.
+ *
+ * The bench never resets video, so libobs has no graphics context.  These
+ * definitions take the place of the libobs entry points the browser source
+ * calls: textures live in system memory, so an upload still costs the copy
+ * it does on a real device, and the graphics lock is a plain recursive
+ * mutex, so paints still wait on Tick/Render the way they do in OBS.
+ * Drawing calls only keep count. */
+
+#include <obs.h>
+#include <graphics/graphics.h>
+#include <graphics/vec4.h>
+#include <string.h>
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+struct gs_texture {
+	uint32_t cx;
+	uint32_t cy;
+	enum gs_color_format format;
+	std::vector<uint8_t> data;
+};
+
+struct gs_texture_render {
+	gs_texture_t *target = nullptr;
+	enum gs_color_format format;
+	bool rendered = false;
+};
+
+static std::recursive_mutex graphics_mutex;
+static thread_local bool effect_looping = false;
+static bool framebuffer_srgb = false;
+
+std::atomic<uint64_t> bench_draws{0};
+
+void obs_enter_graphics(void)
+{
+	graphics_mutex.lock();
+}
+
+void obs_leave_graphics(void)
+{
+	graphics_mutex.unlock();
+}
+
+/* ========================================================================= */
+
+gs_texture_t *gs_texture_create(uint32_t width, uint32_t height,
+				enum gs_color_format color_format,
+				uint32_t levels, const uint8_t **data,
+				uint32_t flags)
+{
+	gs_texture_t *tex = new gs_texture;
+	tex->cx = width;
+	tex->cy = height;
+	tex->format = color_format;
+	tex->data.resize((size_t)width * (size_t)height * 4);
+
+	if (data && *data)
+		memcpy(tex->data.data(), *data, tex->data.size());
+
+	UNUSED_PARAMETER(levels);
+	UNUSED_PARAMETER(flags);
+	return tex;
+}
+
+void gs_texture_destroy(gs_texture_t *tex)
+{
+	delete tex;
+}
+
+uint32_t gs_texture_get_width(const gs_texture_t *tex)
+{
+	return tex ? tex->cx : 0;
+}
+
+uint32_t gs_texture_get_height(const gs_texture_t *tex)
+{
+	return tex ? tex->cy : 0;
+}
+
+enum gs_color_format gs_texture_get_color_format(const gs_texture_t *tex)
+{
+	return tex ? tex->format : GS_UNKNOWN;
+}
+
+void gs_texture_set_image(gs_texture_t *tex, const uint8_t *data,
+			  uint32_t linesize, bool invert)
+{
+	if (!tex || !data)
+		return;
+
+	const size_t row = (size_t)tex->cx * 4;
+	for (uint32_t y = 0; y < tex->cy; y++) {
+		const uint32_t src_y = invert ? tex->cy - y - 1 : y;
+		memcpy(tex->data.data() + row * y,
+		       data + (size_t)linesize * src_y, row);
+	}
+}
+
+void gs_copy_texture(gs_texture_t *dst, gs_texture_t *src)
+{
+	if (dst && src && dst->data.size() == src->data.size())
+		memcpy(dst->data.data(), src->data.data(), dst->data.size());
+}
+
+/* ========================================================================= */
+
+gs_texrender_t *gs_texrender_create(enum gs_color_format format,
+				    enum gs_zstencil_format zsformat)
+{
+	gs_texrender_t *texrender = new gs_texture_render;
+	texrender->format = format;
+
+	UNUSED_PARAMETER(zsformat);
+	return texrender;
+}
+
+void gs_texrender_destroy(gs_texrender_t *texrender)
+{
+	if (texrender) {
+		gs_texture_destroy(texrender->target);
+		delete texrender;
+	}
+}
+
+bool gs_texrender_begin(gs_texrender_t *texrender, uint32_t cx, uint32_t cy)
+{
+	if (!texrender || texrender->rendered || !cx || !cy)
+		return false;
+
+	if (gs_texture_get_width(texrender->target) != cx ||
+	    gs_texture_get_height(texrender->target) != cy) {
+		gs_texture_destroy(texrender->target);
+		texrender->target = gs_texture_create(cx, cy, texrender->format,
+						      1, nullptr,
+						      GS_RENDER_TARGET);
+	}
+
+	return true;
+}
+
+void gs_texrender_end(gs_texrender_t *texrender)
+{
+	if (texrender)
+		texrender->rendered = true;
+}
+
+void gs_texrender_reset(gs_texrender_t *texrender)
+{
+	if (texrender)
+		texrender->rendered = false;
+}
+
+gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender)
+{
+	return texrender ? texrender->target : nullptr;
+}
+
+/* ========================================================================= */
+
+void gs_clear(uint32_t clear_flags, const struct vec4 *color, float depth,
+	      uint8_t stencil)
+{
+	UNUSED_PARAMETER(clear_flags);
+	UNUSED_PARAMETER(color);
+	UNUSED_PARAMETER(depth);
+	UNUSED_PARAMETER(stencil);
+}
+
+void gs_ortho(float left, float right, float top, float bottom, float znear,
+	      float zfar)
+{
+	UNUSED_PARAMETER(left);
+	UNUSED_PARAMETER(right);
+	UNUSED_PARAMETER(top);
+	UNUSED_PARAMETER(bottom);
+	UNUSED_PARAMETER(znear);
+	UNUSED_PARAMETER(zfar);
+}
+
+bool gs_framebuffer_srgb_enabled(void)
+{
+	return framebuffer_srgb;
+}
+
+void gs_enable_framebuffer_srgb(bool enable)
+{
+	framebuffer_srgb = enable;
+}
+
+void gs_blend_state_push(void) {}
+
+void gs_blend_state_pop(void) {}
+
+void gs_enable_blending(bool enable)
+{
+	UNUSED_PARAMETER(enable);
+}
+
+void gs_blend_function(enum gs_blend_type src, enum gs_blend_type dest)
+{
+	UNUSED_PARAMETER(src);
+	UNUSED_PARAMETER(dest);
+}
+
+/* ========================================================================= */
+
+gs_eparam_t *gs_effect_get_param_by_name(const gs_effect_t *effect,
+					 const char *name)
+{
+	UNUSED_PARAMETER(effect);
+	UNUSED_PARAMETER(name);
+	return nullptr;
+}
+
+void gs_effect_set_texture(gs_eparam_t *param, gs_texture_t *val)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(val);
+}
+
+void gs_effect_set_texture_srgb(gs_eparam_t *param, gs_texture_t *val)
+{
+	UNUSED_PARAMETER(param);
+	UNUSED_PARAMETER(val);
+}
+
+/* one pass per technique, like the default effect */
+bool gs_effect_loop(gs_effect_t *effect, const char *name)
+{
+	UNUSED_PARAMETER(effect);
+	UNUSED_PARAMETER(name);
+
+	effect_looping = !effect_looping;
+	return effect_looping;
+}
+
+void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
+		    uint32_t height)
+{
+	if (tex)
+		bench_draws++;
+
+	UNUSED_PARAMETER(flip);
+	UNUSED_PARAMETER(width);
+	UNUSED_PARAMETER(height);
+}
@@ -0,0 +1,598 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/* Headless benchmark for the browser source pipeline.
+ *
+ * Runs N browser sources per fixture page in a libobs without video.  The
+ * sources are the plugin's own BrowserSource/BrowserClient, so paints take
+ * the real OnPaint -> UploadFrame path (or the A/V sync queue) through the
+ * texture pool, and JS events go out through DispatchJSEvent.  A thread
+ * stands in for the OBS graphics thread and ticks and renders the sources
+ * at the canvas rate.  There is no GPU: the graphics entry points are
+ * stubbed with system memory textures (obs-browser-bench-graphics.cpp) and
+ * Chromium is forced onto software compositing.  Results are written as
+ * one JSON object per fixture, per line.
+ *
+ *   obs-browser-bench [--fixtures=static,canvas] [--sources=4]
+ *                     [--width=1920] [--height=1080] [--fps=30]
+ *                     [--warmup=2] [--duration=10] [--event-rate=1000]
+ *                     [--sync-av-offset=0] [--fixtures-dir=path]
+ *                     [--output=file]
+ *
+ * Any other switches are passed on to CEF. */
+
+#include <obs-module.h>
+#include <util/base.h>
+#include <util/platform.h>
+#include "obs-browser-source.hpp"
+#include "browser-app.hpp"
+#include "browser-process-stats.hpp"
+#include "browser-task-monitor.hpp"
+#include "json11/json11.hpp"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <functional>
+#include <map>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace json11;
+
+/* The bench isn't loaded as a module.  Without a config directory the
+ * memory budget and the global request rules are off, and without a
+ * locale module text is its key. */
+OBS_DECLARE_MODULE()
+OBS_MODULE_USE_DEFAULT_LOCALE("obs-browser", "en-US")
+
+extern void DispatchJSEvent(std::string eventName, std::string jsonString,
+			    BrowserSource *browser = nullptr);
+extern void ClearTexturePool();
+extern std::atomic<uint64_t> bench_draws;
+
+struct BenchOptions {
+	std::string fixtures_dir = BENCH_FIXTURES_DIR;
+	std::vector<std::string> fixtures = {"static", "css-animation",
+					     "canvas", "video", "event-storm"};
+	int sources = 4;
+	int width = 1920;
+	int height = 1080;
+	int fps = 30;
+	int warmup = 2;
+	int duration = 10;
+	int event_rate = 1000;
+	int sync_av_offset = 0;
+	std::string output;
+};
+
+static BenchOptions options;
+static FILE *output = stdout;
+
+/* ========================================================================= */
+
+/* What obs-browser-plugin.cpp provides to the sources in OBS */
+
+bool hwaccel = false;
+
+class BenchTask : public CefTask {
+public:
+	std::function<void()> task;
+
+	inline BenchTask(std::function<void()> task_) : task(task_) {}
+	virtual void Execute() override { task(); }
+
+	IMPLEMENT_REFCOUNTING(BenchTask);
+};
+
+bool QueueCEFTask(std::function<void()> task, TaskCategory category)
+{
+	uint64_t queued_ts = os_gettime_ns();
+	std::function<void()> wrapped = [task, category, queued_ts]() {
+		TaskMonitorScope scope(category, queued_ts);
+		task();
+	};
+
+	return CefPostTask(TID_UI,
+			   CefRefPtr<BenchTask>(new BenchTask(wrapped)));
+}
+
+class BenchApp : public BrowserApp {
+public:
+	virtual void OnBeforeCommandLineProcessing(
+		const CefString &process_type,
+		CefRefPtr<CefCommandLine> command_line) override
+	{
+		BrowserApp::OnBeforeCommandLineProcessing(process_type,
+							  command_line);
+
+		/* no GPU whatever the command line says, and nothing to play
+		 * the fixtures' audio on */
+		if (process_type.empty()) {
+			command_line->AppendSwitch("disable-gpu");
+			if (!command_line->HasSwitch("disable-gpu-compositing"))
+				command_line->AppendSwitch(
+					"disable-gpu-compositing");
+			command_line->AppendSwitch("mute-audio");
+		}
+	}
+};
+
+static void RegisterBenchSource()
+{
+	struct obs_source_info info = {};
+	info.id = "browser_source";
+	info.type = OBS_SOURCE_TYPE_INPUT;
+	info.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW |
+			    OBS_SOURCE_SRGB;
+
+	info.get_name = [](void *) { return "Browser"; };
+	info.create = [](obs_data_t *settings, obs_source_t *source) -> void * {
+		return new BrowserSource(settings, source);
+	};
+	info.destroy = [](void *data) {
+		static_cast<BrowserSource *>(data)->Destroy();
+	};
+	info.update = [](void *data, obs_data_t *settings) {
+		static_cast<BrowserSource *>(data)->Update(settings);
+	};
+	info.get_width = [](void *data) {
+		return (uint32_t) static_cast<BrowserSource *>(data)->width;
+	};
+	info.get_height = [](void *data) {
+		return (uint32_t) static_cast<BrowserSource *>(data)->height;
+	};
+	info.video_tick = [](void *data, float) {
+		static_cast<BrowserSource *>(data)->Tick();
+	};
+	info.video_render = [](void *data, gs_effect_t *) {
+		static_cast<BrowserSource *>(data)->Render();
+	};
+	info.show = [](void *data) {
+		static_cast<BrowserSource *>(data)->SetShowing(true);
+	};
+	info.hide = [](void *data) {
+		static_cast<BrowserSource *>(data)->SetShowing(false);
+	};
+
+	obs_register_source(&info);
+}
+
+/* ========================================================================= */
+
+#define EVENT_INTERVAL_NS 10000000ULL
+#define CLOSE_WAIT_MS 1000
+
+struct BenchCounters {
+	uint64_t paints = 0;
+	uint64_t skipped_frames = 0;
+	uint64_t upload_bytes = 0;
+	uint64_t upload_ns = 0;
+	uint64_t graphics_wait_ns = 0;
+	uint64_t ipc_in = 0;
+	uint64_t ipc_out = 0;
+
+	inline BenchCounters() {}
+	inline BenchCounters(const BrowserStats &stats)
+		: paints(stats.paints),
+		  skipped_frames(stats.skipped_frames),
+		  upload_bytes(stats.upload_bytes),
+		  upload_ns(stats.upload_ns),
+		  graphics_wait_ns(stats.graphics_wait_ns),
+		  ipc_in(stats.ipc_in),
+		  ipc_out(stats.ipc_out)
+	{
+	}
+};
+
+struct BenchSource {
+	obs_source_t *source = nullptr;
+	BrowserSource *bs = nullptr;
+	BenchCounters start;
+};
+
+static std::vector<BenchSource> sources;
+static std::atomic<bool> events_running{false};
+
+static void EventThread()
+{
+	const int per_tick =
+		(int)((uint64_t)options.event_rate * EVENT_INTERVAL_NS /
+		      1000000000ULL);
+	uint64_t next = os_gettime_ns();
+	int n = 0;
+
+	while (events_running) {
+		for (int i = 0; i < per_tick; i++) {
+			Json json = Json::object{{"n", ++n}};
+			DispatchJSEvent("obsBenchEvent", json.dump());
+		}
+
+		next += EVENT_INTERVAL_NS;
+		os_sleepto_ns(next);
+	}
+}
+
+/* Ticks every source, then renders them all with the graphics lock held,
+ * once per canvas frame like the graphics thread does */
+static void RunFrames(uint64_t end_ts)
+{
+	const uint64_t interval = 1000000000ULL / (uint64_t)options.fps;
+	const float seconds = 1.0f / (float)options.fps;
+	uint64_t next = os_gettime_ns();
+
+	while (next < end_ts) {
+		for (BenchSource &bench : sources)
+			obs_source_video_tick(bench.source, seconds);
+
+		obs_enter_graphics();
+		for (BenchSource &bench : sources)
+			obs_source_video_render(bench.source);
+		obs_leave_graphics();
+
+		next += interval;
+		os_sleepto_ns(next);
+	}
+}
+
+static obs_data_t *GetFixtureSettings(const std::string &fixture)
+{
+	const std::string url =
+		"file://" + options.fixtures_dir + "/" + fixture + ".html";
+	obs_data_t *settings = obs_data_create();
+
+	obs_data_set_string(settings, "url", url.c_str());
+	obs_data_set_int(settings, "width", options.width);
+	obs_data_set_int(settings, "height", options.height);
+	obs_data_set_bool(settings, "fps_custom", true);
+	obs_data_set_int(settings, "fps", options.fps);
+	obs_data_set_bool(settings, "reroute_audio", false);
+	obs_data_set_int(settings, "webpage_control_level",
+			 (int)DEFAULT_CONTROL_LEVEL);
+	obs_data_set_int(settings, "asset_cache",
+			 (int)DEFAULT_ASSET_CACHE_POLICY);
+	obs_data_set_bool(settings, "memory_limit_inactive", true);
+	obs_data_set_bool(settings, "sync_av", options.sync_av_offset > 0);
+	obs_data_set_int(settings, "sync_av_offset", options.sync_av_offset);
+	return settings;
+}
+
+static void CreateSources(const std::string &fixture)
+{
+	obs_data_t *settings = GetFixtureSettings(fixture);
+
+	for (int i = 0; i < options.sources; i++) {
+		std::string name = fixture + " " + std::to_string(i + 1);
+		BenchSource bench;
+
+		bench.source = obs_source_create_private(
+			"browser_source", name.c_str(), settings);
+		if (!bench.source)
+			continue;
+
+		bench.bs = static_cast<BrowserSource *>(
+			obs_obj_get_data(bench.source));
+		obs_source_inc_showing(bench.source);
+		sources.push_back(bench);
+	}
+
+	obs_data_release(settings);
+}
+
+static void DestroySources()
+{
+	for (BenchSource &bench : sources) {
+		obs_source_dec_showing(bench.source);
+		obs_source_release(bench.source);
+	}
+	sources.clear();
+}
+
+/* Renderer processes can be shared between sources, so CPU and memory are
+ * sampled per process and split evenly between its sources */
+static std::map<int, int> GetRendererSources()
+{
+	std::map<int, int> pids;
+	for (BenchSource &bench : sources) {
+		int pid = bench.bs->stats.renderer_pid;
+		if (pid)
+			pids[pid]++;
+	}
+	return pids;
+}
+
+static Json GetResult(const std::string &fixture, double elapsed,
+		      const std::map<int, ProcessSample> &start_samples,
+		      const ProcessSample &start_self, uint64_t draws)
+{
+	std::map<int, int> renderers = GetRendererSources();
+	std::map<int, Json> renderer_json;
+
+	for (auto &renderer : renderers) {
+		ProcessSample sample;
+		auto start = start_samples.find(renderer.first);
+		if (start == start_samples.end() ||
+		    !SampleProcess(renderer.first, sample))
+			continue;
+
+		double cpu = (double)(sample.cpu_ns - start->second.cpu_ns) /
+			     1e9 / elapsed;
+		renderer_json[renderer.first] = Json::object{
+			{"pid", renderer.first},
+			{"sources", renderer.second},
+			{"cpu", cpu},
+			{"rss_mb", (double)sample.rss / (1024.0 * 1024.0)},
+		};
+	}
+
+	Json::array per_source;
+	uint64_t total_paints = 0;
+	uint64_t total_bytes = 0;
+
+	for (BenchSource &bench : sources) {
+		const BrowserStats &stats = bench.bs->stats;
+		const BenchCounters &start = bench.start;
+		BenchCounters end(stats);
+		const uint64_t paints = end.paints - start.paints;
+		const uint64_t bytes = end.upload_bytes - start.upload_bytes;
+		/* nanoseconds to milliseconds per paint */
+		const double per_paint = paints ? 1e6 * (double)paints : 1.0;
+		const int pid = stats.renderer_pid;
+		double cpu = 0.0;
+
+		auto it = renderer_json.find(pid);
+		if (it != renderer_json.end())
+			cpu = it->second["cpu"].number_value() /
+			      it->second["sources"].number_value();
+
+		total_paints += paints;
+		total_bytes += bytes;
+
+		per_source.push_back(Json::object{
+			{"fps", (double)paints / elapsed},
+			{"skipped_frames",
+			 (double)(end.skipped_frames - start.skipped_frames)},
+			{"upload_mb_per_s",
+			 (double)bytes / (1024.0 * 1024.0) / elapsed},
+			{"upload_ms",
+			 (double)(end.upload_ns - start.upload_ns) / per_paint},
+			{"graphics_wait_ms",
+			 (double)(end.graphics_wait_ns -
+				  start.graphics_wait_ns) /
+				 per_paint},
+			{"ipc_in", (double)(end.ipc_in - start.ipc_in)},
+			{"ipc_out", (double)(end.ipc_out - start.ipc_out)},
+			{"ipc_rtt", stats.ipc_rtt.ToJson()},
+			{"frame_age", stats.frame_age.ToJson()},
+			{"renderer_pid", pid},
+			{"cpu", cpu},
+		});
+	}
+
+	Json::array renderer_list;
+	for (auto &renderer : renderer_json)
+		renderer_list.push_back(renderer.second);
+
+	ProcessSample self;
+	double browser_cpu = 0.0;
+	if (SampleProcess(getpid(), self))
+		browser_cpu = (double)(self.cpu_ns - start_self.cpu_ns) / 1e9 /
+			      elapsed;
+
+	return Json::object{
+		{"fixture", fixture},
+		{"sources", options.sources},
+		{"width", options.width},
+		{"height", options.height},
+		{"target_fps", options.fps},
+		{"sync_av_offset", options.sync_av_offset},
+		{"duration", elapsed},
+		{"fps", (double)total_paints / elapsed / options.sources},
+		{"upload_mb_per_s",
+		 (double)total_bytes / (1024.0 * 1024.0) / elapsed},
+		{"draws_per_s", (double)draws / elapsed},
+		{"browser_cpu", browser_cpu},
+		{"renderers", renderer_list},
+		{"per_source", per_source},
+	};
+}
+
+static void RunFixture(const std::string &fixture)
+{
+	CreateSources(fixture);
+	if (sources.empty()) {
+		blog(LOG_ERROR, "[obs-browser-bench]: Failed to create '%s'",
+		     fixture.c_str());
+		return;
+	}
+
+	RunFrames(os_gettime_ns() + (uint64_t)options.warmup * 1000000000ULL);
+
+	/* counters are measured from here, the latency histograms also
+	 * cover the warmup */
+	std::map<int, ProcessSample> start_samples;
+	for (auto &renderer : GetRendererSources()) {
+		ProcessSample sample;
+		if (SampleProcess(renderer.first, sample))
+			start_samples[renderer.first] = sample;
+	}
+
+	ProcessSample start_self;
+	SampleProcess(getpid(), start_self);
+
+	for (BenchSource &bench : sources)
+		bench.start = BenchCounters(bench.bs->stats);
+
+	std::thread events;
+	if (fixture == "event-storm") {
+		events_running = true;
+		events = std::thread(EventThread);
+	}
+
+	const uint64_t start_draws = bench_draws;
+	const uint64_t start = os_gettime_ns();
+	RunFrames(start + (uint64_t)options.duration * 1000000000ULL);
+	const double elapsed = (double)(os_gettime_ns() - start) / 1e9;
+
+	if (events.joinable()) {
+		events_running = false;
+		events.join();
+	}
+
+	Json result = GetResult(fixture, elapsed, start_samples, start_self,
+				bench_draws - start_draws);
+	fprintf(output, "%s\n", result.dump().c_str());
+	fflush(output);
+
+	/* the browsers close on the CEF thread, give them time to go before
+	 * the next fixture is measured */
+	DestroySources();
+	os_sleep_ms(CLOSE_WAIT_MS);
+}
+
+static void BenchThread()
+{
+	os_set_thread_name("bench graphics");
+
+	for (const std::string &fixture : options.fixtures)
+		RunFixture(fixture);
+
+	while (!QueueCEFTask([]() { CefQuitMessageLoop(); }))
+		os_sleep_ms(5);
+}
+
+/* ========================================================================= */
+
+/* results go to stdout, the log to stderr */
+static void LogHandler(int level, const char *format, va_list args, void *)
+{
+	if (level > LOG_INFO)
+		return;
+
+	vfprintf(stderr, format, args);
+	fputc('\n', stderr);
+}
+
+static std::vector<std::string> SplitList(const std::string &str)
+{
+	std::vector<std::string> list;
+	std::stringstream stream(str);
+	std::string item;
+
+	while (std::getline(stream, item, ','))
+		if (!item.empty())
+			list.push_back(item);
+	return list;
+}
+
+static int GetIntSwitch(CefRefPtr<CefCommandLine> command_line,
+			const char *name, int def, int min)
+{
+	if (!command_line->HasSwitch(name))
+		return def;
+
+	int val = atoi(command_line->GetSwitchValue(name).ToString().c_str());
+	return val < min ? min : val;
+}
+
+static void ReadOptions(int argc, char *argv[])
+{
+	CefRefPtr<CefCommandLine> command_line =
+		CefCommandLine::CreateCommandLine();
+	command_line->InitFromArgv(argc, argv);
+
+	if (command_line->HasSwitch("fixtures"))
+		options.fixtures = SplitList(
+			command_line->GetSwitchValue("fixtures").ToString());
+	if (command_line->HasSwitch("fixtures-dir"))
+		options.fixtures_dir =
+			command_line->GetSwitchValue("fixtures-dir").ToString();
+	if (command_line->HasSwitch("output"))
+		options.output =
+			command_line->GetSwitchValue("output").ToString();
+
+	options.sources = GetIntSwitch(command_line, "sources", 4, 1);
+	options.width = GetIntSwitch(command_line, "width", 1920, 1);
+	options.height = GetIntSwitch(command_line, "height", 1080, 1);
+	options.fps = GetIntSwitch(command_line, "fps", 30, 1);
+	options.warmup = GetIntSwitch(command_line, "warmup", 2, 0);
+	options.duration = GetIntSwitch(command_line, "duration", 10, 1);
+	options.event_rate =
+		GetIntSwitch(command_line, "event-rate", 1000, 0);
+	options.sync_av_offset =
+		GetIntSwitch(command_line, "sync-av-offset", 0, 0);
+}
+
+int main(int argc, char *argv[])
+{
+	CefMainArgs mainArgs(argc, argv);
+	CefRefPtr<BenchApp> app(new BenchApp());
+
+	/* the bench is its own renderer/GPU/utility subprocess */
+	int ret = CefExecuteProcess(mainArgs, app.get(), nullptr);
+	if (ret >= 0)
+		return ret;
+
+	ReadOptions(argc, argv);
+
+	if (!options.output.empty()) {
+		output = fopen(options.output.c_str(), "w");
+		if (!output) {
+			fprintf(stderr, "Failed to open '%s'\n",
+				options.output.c_str());
+			return 1;
+		}
+	}
+
+	base_set_log_handler(LogHandler, nullptr);
+
+	/* measure the IPC round trip unless told not to */
+	setenv("OBS_BROWSER_IPC_PROBE", "1", 0);
+
+	if (!obs_startup("en-US", nullptr, nullptr)) {
+		fprintf(stderr, "Failed to start libobs\n");
+		return 1;
+	}
+	RegisterBenchSource();
+
+	CefSettings settings;
+	settings.log_severity = LOGSEVERITY_WARNING;
+	settings.windowless_rendering_enabled = true;
+	settings.no_sandbox = true;
+
+	if (!CefInitialize(mainArgs, settings, app.get(), nullptr)) {
+		obs_shutdown();
+		return 1;
+	}
+
+	TaskMonitorStart();
+
+	std::thread bench(BenchThread);
+	CefRunMessageLoop();
+	bench.join();
+
+	ClearTexturePool();
+	CefShutdown();
+	TaskMonitorStop();
+	obs_shutdown();
+
+	if (output != stdout)
+		fclose(output);
+	return 0;
+}
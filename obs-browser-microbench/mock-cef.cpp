@@ -0,0 +1,466 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+#include "mock-cef.hpp"
+#include <string.h>
+#include <deque>
+#include <mutex>
+
+std::atomic<uint64_t> mock_cef_messages{0};
+std::atomic<uint64_t> mock_cef_message_bytes{0};
+
+/* ========================================================================= */
+
+static void AppendUTF16(std::u16string &out, const char *utf8, size_t size)
+{
+	const uint8_t *in = (const uint8_t *)utf8;
+	const uint8_t *end = in + size;
+
+	out.reserve(out.size() + size);
+
+	while (in < end) {
+		uint32_t c = *in++;
+		int extra = 0;
+
+		if (c >= 0xF0 && c < 0xF8) {
+			c &= 0x07;
+			extra = 3;
+		} else if (c >= 0xE0) {
+			c &= 0x0F;
+			extra = 2;
+		} else if (c >= 0xC0) {
+			c &= 0x1F;
+			extra = 1;
+		} else if (c >= 0x80) {
+			c = 0xFFFD;
+		}
+
+		for (; extra > 0; extra--) {
+			if (in == end || (*in & 0xC0) != 0x80) {
+				c = 0xFFFD;
+				break;
+			}
+			c = (c << 6) | (*in++ & 0x3F);
+		}
+
+		if (c >= 0x10000) {
+			c -= 0x10000;
+			out.push_back((char16_t)(0xD800 + (c >> 10)));
+			out.push_back((char16_t)(0xDC00 + (c & 0x3FF)));
+		} else {
+			out.push_back((char16_t)c);
+		}
+	}
+}
+
+CefString::CefString(const char *utf8)
+{
+	if (utf8)
+		AppendUTF16(str, utf8, strlen(utf8));
+}
+
+CefString::CefString(const std::string &utf8)
+{
+	AppendUTF16(str, utf8.data(), utf8.size());
+}
+
+std::string CefString::ToString() const
+{
+	std::string out;
+	out.reserve(str.size());
+
+	for (size_t i = 0; i < str.size(); i++) {
+		uint32_t c = str[i];
+
+		if (c >= 0xD800 && c < 0xDC00 && i + 1 < str.size() &&
+		    str[i + 1] >= 0xDC00 && str[i + 1] < 0xE000) {
+			c = 0x10000 + ((c - 0xD800) << 10) +
+			    (str[++i] - 0xDC00);
+		} else if (c >= 0xD800 && c < 0xE000) {
+			c = 0xFFFD;
+		}
+
+		if (c < 0x80) {
+			out.push_back((char)c);
+		} else if (c < 0x800) {
+			out.push_back((char)(0xC0 | (c >> 6)));
+			out.push_back((char)(0x80 | (c & 0x3F)));
+		} else if (c < 0x10000) {
+			out.push_back((char)(0xE0 | (c >> 12)));
+			out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+			out.push_back((char)(0x80 | (c & 0x3F)));
+		} else {
+			out.push_back((char)(0xF0 | (c >> 18)));
+			out.push_back((char)(0x80 | ((c >> 12) & 0x3F)));
+			out.push_back((char)(0x80 | ((c >> 6) & 0x3F)));
+			out.push_back((char)(0x80 | (c & 0x3F)));
+		}
+	}
+
+	return out;
+}
+
+CefString CefURIEncode(const CefString &text, bool use_plus)
+{
+	static const char hex[] = "0123456789ABCDEF";
+	const std::string in = text.ToString();
+	std::string out;
+	out.reserve(in.size() * 3);
+
+	for (unsigned char c : in) {
+		const bool unreserved = c && strchr("-_.!~*'()", c);
+
+		if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+		    (c >= '0' && c <= '9') || unreserved) {
+			out.push_back((char)c);
+		} else if (c == ' ' && use_plus) {
+			out.push_back('+');
+		} else {
+			out.push_back('%');
+			out.push_back(hex[c >> 4]);
+			out.push_back(hex[c & 0xF]);
+		}
+	}
+
+	return out;
+}
+
+/* ========================================================================= */
+
+CefRefPtr<CefListValue> CefListValue::Create()
+{
+	return new CefListValue;
+}
+
+CefListValue::Value &CefListValue::At(size_t index)
+{
+	if (index >= values.size())
+		values.resize(index + 1);
+	return values[index];
+}
+
+const CefListValue::Value *CefListValue::Find(size_t index,
+					      cef_value_type_t type) const
+{
+	if (index >= values.size() || values[index].type != type)
+		return nullptr;
+	return &values[index];
+}
+
+bool CefListValue::SetSize(size_t size)
+{
+	values.resize(size);
+	return true;
+}
+
+cef_value_type_t CefListValue::GetType(size_t index) const
+{
+	return index < values.size() ? values[index].type : VTYPE_INVALID;
+}
+
+bool CefListValue::SetBool(size_t index, bool value)
+{
+	Value &v = At(index);
+	v.type = VTYPE_BOOL;
+	v.b = value;
+	return true;
+}
+
+bool CefListValue::SetInt(size_t index, int value)
+{
+	Value &v = At(index);
+	v.type = VTYPE_INT;
+	v.i = value;
+	return true;
+}
+
+bool CefListValue::SetDouble(size_t index, double value)
+{
+	Value &v = At(index);
+	v.type = VTYPE_DOUBLE;
+	v.d = value;
+	return true;
+}
+
+bool CefListValue::SetString(size_t index, const CefString &value)
+{
+	Value &v = At(index);
+	v.type = VTYPE_STRING;
+	v.s = value;
+	return true;
+}
+
+bool CefListValue::GetBool(size_t index) const
+{
+	const Value *v = Find(index, VTYPE_BOOL);
+	return v ? v->b : false;
+}
+
+int CefListValue::GetInt(size_t index) const
+{
+	const Value *v = Find(index, VTYPE_INT);
+	return v ? v->i : 0;
+}
+
+double CefListValue::GetDouble(size_t index) const
+{
+	const Value *v = Find(index, VTYPE_DOUBLE);
+	return v ? v->d : 0.0;
+}
+
+CefString CefListValue::GetString(size_t index) const
+{
+	const Value *v = Find(index, VTYPE_STRING);
+	return v ? v->s : CefString();
+}
+
+/* ------------------------------------------------------------------------- */
+
+CefRefPtr<CefDictionaryValue> CefDictionaryValue::Create()
+{
+	return new CefDictionaryValue;
+}
+
+bool CefDictionaryValue::HasKey(const CefString &key) const
+{
+	return strings.find(key) != strings.end();
+}
+
+bool CefDictionaryValue::SetString(const CefString &key,
+				   const CefString &value)
+{
+	strings[key] = value;
+	return true;
+}
+
+CefString CefDictionaryValue::GetString(const CefString &key) const
+{
+	auto it = strings.find(key);
+	return it != strings.end() ? it->second : CefString();
+}
+
+/* ------------------------------------------------------------------------- */
+
+CefRefPtr<CefProcessMessage> CefProcessMessage::Create(const CefString &name)
+{
+	return new CefProcessMessage(name);
+}
+
+static void EncodeString(std::vector<uint8_t> &data, const CefString &str)
+{
+	const uint32_t length = (uint32_t)str.length();
+	const uint8_t *chars = (const uint8_t *)str.c_str();
+
+	data.insert(data.end(), (const uint8_t *)&length,
+		    (const uint8_t *)&length + sizeof(length));
+	data.insert(data.end(), chars, chars + length * sizeof(char16_t));
+}
+
+template<typename T> static void EncodeValue(std::vector<uint8_t> &data, T val)
+{
+	data.insert(data.end(), (const uint8_t *)&val,
+		    (const uint8_t *)&val + sizeof(val));
+}
+
+/* Flattens |message| into |data| the way IPC would, strings as their
+ * length followed by their UTF-16 code units */
+static void EncodeMessage(std::vector<uint8_t> &data,
+			  CefRefPtr<CefProcessMessage> message)
+{
+	CefRefPtr<CefListValue> args = message->GetArgumentList();
+	const size_t size = args->GetSize();
+
+	EncodeString(data, message->GetName());
+	EncodeValue(data, (uint32_t)size);
+
+	for (size_t i = 0; i < size; i++) {
+		cef_value_type_t type = args->GetType(i);
+		EncodeValue(data, (uint8_t)type);
+
+		switch (type) {
+		case VTYPE_BOOL:
+			EncodeValue(data, (uint8_t)args->GetBool(i));
+			break;
+		case VTYPE_INT:
+			EncodeValue(data, args->GetInt(i));
+			break;
+		case VTYPE_DOUBLE:
+			EncodeValue(data, args->GetDouble(i));
+			break;
+		case VTYPE_STRING:
+			EncodeString(data, args->GetString(i));
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+/* ========================================================================= */
+
+static std::mutex task_mutex;
+static std::deque<CefRefPtr<CefTask>> tasks;
+
+bool CefPostTask(CefThreadId, CefRefPtr<CefTask> task)
+{
+	std::lock_guard<std::mutex> lock(task_mutex);
+	tasks.push_back(task);
+	return true;
+}
+
+bool CefPostDelayedTask(CefThreadId thread_id, CefRefPtr<CefTask> task,
+			int64_t)
+{
+	return CefPostTask(thread_id, task);
+}
+
+size_t MockCefRunTasks()
+{
+	size_t count = 0;
+
+	for (;;) {
+		CefRefPtr<CefTask> task;
+		{
+			std::lock_guard<std::mutex> lock(task_mutex);
+			if (tasks.empty())
+				break;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+
+		task->Execute();
+		count++;
+	}
+
+	return count;
+}
+
+/* ========================================================================= */
+
+class MockBrowser;
+
+class MockFrame : public CefFrame {
+	MockBrowser *browser;
+
+public:
+	inline MockFrame(MockBrowser *browser_) : browser(browser_) {}
+
+	virtual bool IsValid() override { return !!browser; }
+	virtual bool IsMain() override { return true; }
+	virtual CefRefPtr<CefBrowser> GetBrowser() override;
+	virtual void
+	SendProcessMessage(CefProcessId,
+			   CefRefPtr<CefProcessMessage> message) override
+	{
+		/* the buffer is reused, like the IPC channel's would be */
+		static thread_local std::vector<uint8_t> data;
+		data.clear();
+		EncodeMessage(data, message);
+
+		mock_cef_messages++;
+		mock_cef_message_bytes += data.size();
+	}
+
+	inline void Detach() { browser = nullptr; }
+
+	IMPLEMENT_REFCOUNTING(MockFrame);
+};
+
+class MockBrowserHost : public CefBrowserHost {
+	MockBrowser *browser;
+	CefRefPtr<CefClient> client;
+
+public:
+	inline MockBrowserHost(MockBrowser *browser_,
+			       CefRefPtr<CefClient> client_)
+		: browser(browser_), client(client_)
+	{
+	}
+
+	virtual CefRefPtr<CefBrowser> GetBrowser() override;
+	virtual CefRefPtr<CefClient> GetClient() override { return client; }
+
+	/* the browser is gone once closed, and takes its client with it */
+	virtual void CloseBrowser(bool) override { client = nullptr; }
+
+	virtual void WasHidden(bool) override {}
+	virtual void Invalidate(cef_paint_element_type_t) override {}
+	virtual void SetAudioMuted(bool) override {}
+	virtual void SetWindowlessFrameRate(int) override {}
+	virtual void SendFocusEvent(bool) override {}
+	virtual void SendKeyEvent(const CefKeyEvent &) override {}
+	virtual void SendMouseClickEvent(const CefMouseEvent &, MouseButtonType,
+					 bool, int) override
+	{
+	}
+	virtual void SendMouseMoveEvent(const CefMouseEvent &, bool) override {}
+	virtual void SendMouseWheelEvent(const CefMouseEvent &, int,
+					 int) override
+	{
+	}
+
+	inline void Detach() { browser = nullptr; }
+
+	IMPLEMENT_REFCOUNTING(MockBrowserHost);
+};
+
+class MockBrowser : public CefBrowser {
+	int id;
+	CefRefPtr<MockBrowserHost> host;
+	CefRefPtr<MockFrame> frame;
+
+public:
+	inline MockBrowser(int id_, CefRefPtr<CefClient> client)
+		: id(id_),
+		  host(new MockBrowserHost(this, client)),
+		  frame(new MockFrame(this))
+	{
+	}
+
+	inline ~MockBrowser()
+	{
+		host->Detach();
+		frame->Detach();
+	}
+
+	virtual CefRefPtr<CefBrowserHost> GetHost() override { return host; }
+	virtual CefRefPtr<CefFrame> GetMainFrame() override { return frame; }
+	virtual int GetIdentifier() override { return id; }
+	virtual void Reload() override {}
+	virtual void ReloadIgnoreCache() override {}
+
+	IMPLEMENT_REFCOUNTING(MockBrowser);
+};
+
+CefRefPtr<CefBrowser> MockFrame::GetBrowser()
+{
+	return browser;
+}
+
+CefRefPtr<CefBrowser> MockBrowserHost::GetBrowser()
+{
+	return browser;
+}
+
+CefRefPtr<CefBrowser>
+CefBrowserHost::CreateBrowserSync(const CefWindowInfo &,
+				  CefRefPtr<CefClient> client,
+				  const CefString &, const CefBrowserSettings &,
+				  CefRefPtr<CefDictionaryValue>,
+				  CefRefPtr<CefRequestContext>)
+{
+	static std::atomic<int> next_id{1};
+	return new MockBrowser(next_id++, client);
+}
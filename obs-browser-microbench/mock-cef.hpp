@@ -0,0 +1,723 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/* Mock of the part of the CEF API the plugin uses, for
+ * obs-browser-microbench.  cef-headers.hpp includes this instead of the CEF
+ * headers when BROWSER_MOCK_CEF is defined.
+ *
+ * The API is the one of CEF 3770 (BROWSER_LEGACY), the only version that
+ * still has the audio streams the plugin mixes itself.  Value types are
+ * implemented here and in mock-cef.cpp; browsers, hosts and frames are
+ * interfaces like in CEF, created by CefBrowserHost::CreateBrowserSync.
+ * Strings are UTF-16 like cef_string_t, so the conversions the plugin pays
+ * for in CEF are paid for here too.
+ *
+ * Nothing runs on its own: tasks posted to CEF threads wait until
+ * MockCefRunTasks, and process messages sent to renderers are encoded and
+ * counted, then dropped. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <string>
+#include <vector>
+
+#define CHROME_VERSION_BUILD 3770
+
+/* ========================================================================= */
+/* Reference counting                                                        */
+
+class CefBaseRefCounted {
+public:
+	virtual void AddRef() const = 0;
+	virtual bool Release() const = 0;
+	virtual bool HasOneRef() const = 0;
+	virtual bool HasAtLeastOneRef() const = 0;
+
+protected:
+	virtual ~CefBaseRefCounted() {}
+};
+
+class CefRefCount {
+	mutable std::atomic<int> ref_count{0};
+
+public:
+	inline void AddRef() const { ref_count++; }
+	inline bool Release() const { return --ref_count == 0; }
+	inline bool HasOneRef() const { return ref_count == 1; }
+	inline bool HasAtLeastOneRef() const { return ref_count >= 1; }
+};
+
+#define IMPLEMENT_REFCOUNTING(ClassName)                               \
+public:                                                                \
+	void AddRef() const override { ref_count_.AddRef(); }          \
+	bool Release() const override                                  \
+	{                                                              \
+		if (ref_count_.Release()) {                            \
+			delete static_cast<const ClassName *>(this);   \
+			return true;                                   \
+		}                                                      \
+		return false;                                          \
+	}                                                              \
+	bool HasOneRef() const override                                \
+	{                                                              \
+		return ref_count_.HasOneRef();                         \
+	}                                                              \
+	bool HasAtLeastOneRef() const override                         \
+	{                                                              \
+		return ref_count_.HasAtLeastOneRef();                  \
+	}                                                              \
+                                                                       \
+private:                                                               \
+	CefRefCount ref_count_
+
+template<class T> class CefRefPtr {
+	T *ptr = nullptr;
+
+public:
+	inline CefRefPtr() {}
+	inline CefRefPtr(std::nullptr_t) {}
+	inline CefRefPtr(T *p) : ptr(p)
+	{
+		if (ptr)
+			ptr->AddRef();
+	}
+	inline CefRefPtr(const CefRefPtr<T> &r) : CefRefPtr(r.ptr) {}
+	template<class U>
+	inline CefRefPtr(const CefRefPtr<U> &r) : CefRefPtr(r.get())
+	{
+	}
+	inline CefRefPtr(CefRefPtr<T> &&r) : ptr(r.ptr) { r.ptr = nullptr; }
+	inline ~CefRefPtr()
+	{
+		if (ptr)
+			ptr->Release();
+	}
+
+	inline CefRefPtr<T> &operator=(T *p)
+	{
+		if (p)
+			p->AddRef();
+		T *old = ptr;
+		ptr = p;
+		if (old)
+			old->Release();
+		return *this;
+	}
+	inline CefRefPtr<T> &operator=(const CefRefPtr<T> &r)
+	{
+		return *this = r.ptr;
+	}
+	template<class U> inline CefRefPtr<T> &operator=(const CefRefPtr<U> &r)
+	{
+		return *this = r.get();
+	}
+	inline CefRefPtr<T> &operator=(CefRefPtr<T> &&r)
+	{
+		if (this != &r) {
+			T *old = ptr;
+			ptr = r.ptr;
+			r.ptr = nullptr;
+			if (old)
+				old->Release();
+		}
+		return *this;
+	}
+
+	inline T *get() const { return ptr; }
+	inline operator T *() const { return ptr; }
+	inline T &operator*() const { return *ptr; }
+	inline T *operator->() const { return ptr; }
+};
+
+template<class T> using CefRawPtr = T *;
+
+/* ========================================================================= */
+/* Strings                                                                   */
+
+/* UTF-16, converted from and to UTF-8 std::strings */
+class CefString {
+	std::u16string str;
+
+public:
+	inline CefString() {}
+	CefString(const char *utf8);
+	CefString(const std::string &utf8);
+
+	inline bool empty() const { return str.empty(); }
+	inline size_t length() const { return str.length(); }
+	inline const char16_t *c_str() const { return str.c_str(); }
+	inline void clear() { str.clear(); }
+
+	std::string ToString() const;
+	inline operator std::string() const { return ToString(); }
+
+	inline bool operator==(const CefString &other) const
+	{
+		return str == other.str;
+	}
+	inline bool operator!=(const CefString &other) const
+	{
+		return str != other.str;
+	}
+	inline bool operator<(const CefString &other) const
+	{
+		return str < other.str;
+	}
+};
+
+/* Escapes everything but letters, digits and -_.!~*'() */
+extern CefString CefURIEncode(const CefString &text, bool use_plus);
+
+/* ========================================================================= */
+/* Enums and plain structs                                                   */
+
+typedef enum {
+	PID_BROWSER,
+	PID_RENDERER,
+} cef_process_id_t;
+typedef cef_process_id_t CefProcessId;
+
+typedef enum {
+	TID_UI,
+	TID_FILE_BACKGROUND,
+	TID_FILE_USER_VISIBLE,
+	TID_FILE_USER_BLOCKING,
+	TID_PROCESS_LAUNCHER,
+	TID_IO,
+	TID_RENDERER,
+} cef_thread_id_t;
+typedef cef_thread_id_t CefThreadId;
+
+typedef enum {
+	LOGSEVERITY_DEFAULT,
+	LOGSEVERITY_VERBOSE,
+	LOGSEVERITY_DEBUG = LOGSEVERITY_VERBOSE,
+	LOGSEVERITY_INFO,
+	LOGSEVERITY_WARNING,
+	LOGSEVERITY_ERROR,
+	LOGSEVERITY_FATAL,
+	LOGSEVERITY_DISABLE = 99,
+} cef_log_severity_t;
+
+typedef enum {
+	STATE_DEFAULT = 0,
+	STATE_ENABLED,
+	STATE_DISABLED,
+} cef_state_t;
+
+typedef enum {
+	TS_ABNORMAL_TERMINATION,
+	TS_PROCESS_WAS_KILLED,
+	TS_PROCESS_CRASHED,
+	TS_PROCESS_OOM,
+} cef_termination_status_t;
+
+typedef enum {
+	PET_VIEW = 0,
+	PET_POPUP,
+} cef_paint_element_type_t;
+
+typedef enum {
+	WOD_UNKNOWN,
+	WOD_CURRENT_TAB,
+	WOD_SINGLETON_TAB,
+	WOD_NEW_FOREGROUND_TAB,
+	WOD_NEW_BACKGROUND_TAB,
+	WOD_NEW_POPUP,
+	WOD_NEW_WINDOW,
+	WOD_SAVE_TO_DISK,
+	WOD_OFF_THE_RECORD,
+	WOD_IGNORE_ACTION
+} cef_window_open_disposition_t;
+
+typedef enum {
+	MBT_LEFT = 0,
+	MBT_MIDDLE,
+	MBT_RIGHT,
+} cef_mouse_button_type_t;
+
+typedef enum {
+	KEYEVENT_RAWKEYDOWN = 0,
+	KEYEVENT_KEYDOWN,
+	KEYEVENT_KEYUP,
+	KEYEVENT_CHAR
+} cef_key_event_type_t;
+
+typedef enum {
+	VTYPE_INVALID = 0,
+	VTYPE_NULL,
+	VTYPE_BOOL,
+	VTYPE_INT,
+	VTYPE_DOUBLE,
+	VTYPE_STRING,
+	VTYPE_BINARY,
+	VTYPE_DICTIONARY,
+	VTYPE_LIST,
+} cef_value_type_t;
+
+typedef enum {
+	CEF_CHANNEL_LAYOUT_NONE = 0,
+	CEF_CHANNEL_LAYOUT_UNSUPPORTED = 1,
+	CEF_CHANNEL_LAYOUT_MONO = 2,
+	CEF_CHANNEL_LAYOUT_STEREO = 3,
+	CEF_CHANNEL_LAYOUT_2_1 = 4,
+	CEF_CHANNEL_LAYOUT_SURROUND = 5,
+	CEF_CHANNEL_LAYOUT_4_0 = 6,
+	CEF_CHANNEL_LAYOUT_2_2 = 7,
+	CEF_CHANNEL_LAYOUT_QUAD = 8,
+	CEF_CHANNEL_LAYOUT_5_0 = 9,
+	CEF_CHANNEL_LAYOUT_5_1 = 10,
+	CEF_CHANNEL_LAYOUT_5_0_BACK = 11,
+	CEF_CHANNEL_LAYOUT_5_1_BACK = 12,
+	CEF_CHANNEL_LAYOUT_7_0 = 13,
+	CEF_CHANNEL_LAYOUT_7_1 = 14,
+	CEF_CHANNEL_LAYOUT_7_1_WIDE = 15,
+	CEF_CHANNEL_LAYOUT_STEREO_DOWNMIX = 16,
+	CEF_CHANNEL_LAYOUT_2POINT1 = 17,
+	CEF_CHANNEL_LAYOUT_3_1 = 18,
+	CEF_CHANNEL_LAYOUT_4_1 = 19,
+	CEF_CHANNEL_LAYOUT_6_0 = 20,
+	CEF_CHANNEL_LAYOUT_6_0_FRONT = 21,
+	CEF_CHANNEL_LAYOUT_HEXAGONAL = 22,
+	CEF_CHANNEL_LAYOUT_6_1 = 23,
+	CEF_CHANNEL_LAYOUT_6_1_BACK = 24,
+	CEF_CHANNEL_LAYOUT_6_1_FRONT = 25,
+	CEF_CHANNEL_LAYOUT_7_0_FRONT = 26,
+	CEF_CHANNEL_LAYOUT_7_1_WIDE_BACK = 27,
+	CEF_CHANNEL_LAYOUT_OCTAGONAL = 28,
+	CEF_CHANNEL_LAYOUT_DISCRETE = 29,
+	CEF_CHANNEL_LAYOUT_STEREO_AND_KEYBOARD_MIC = 30,
+	CEF_CHANNEL_LAYOUT_4_1_QUAD_SIDE = 31,
+	CEF_CHANNEL_LAYOUT_BITSTREAM = 32,
+} cef_channel_layout_t;
+
+class CefRect {
+public:
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+
+	inline CefRect() {}
+	inline CefRect(int x_, int y_, int width_, int height_)
+		: x(x_), y(y_), width(width_), height(height_)
+	{
+	}
+
+	inline void Set(int x_, int y_, int width_, int height_)
+	{
+		x = x_;
+		y = y_;
+		width = width_;
+		height = height_;
+	}
+};
+
+struct CefWindowInfo {
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+	int windowless_rendering_enabled = 0;
+	int shared_texture_enabled = 0;
+	int external_begin_frame_enabled = 0;
+};
+
+struct CefBrowserSettings {
+	int windowless_frame_rate = 0;
+	int default_font_size = 0;
+	int default_fixed_font_size = 0;
+	cef_state_t web_security = STATE_DEFAULT;
+};
+
+struct CefPopupFeatures {
+	int x = 0;
+	int y = 0;
+	int width = 0;
+	int height = 0;
+};
+
+struct CefMouseEvent {
+	int x = 0;
+	int y = 0;
+	uint32_t modifiers = 0;
+};
+
+struct CefKeyEvent {
+	cef_key_event_type_t type = KEYEVENT_RAWKEYDOWN;
+	uint32_t modifiers = 0;
+	int windows_key_code = 0;
+	int native_key_code = 0;
+	int is_system_key = 0;
+	char16_t character = 0;
+	char16_t unmodified_character = 0;
+	int focus_on_editable_field = 0;
+};
+
+/* ========================================================================= */
+/* Values and process messages                                               */
+
+class CefListValue : public virtual CefBaseRefCounted {
+	struct Value {
+		cef_value_type_t type = VTYPE_NULL;
+		bool b = false;
+		int i = 0;
+		double d = 0.0;
+		CefString s;
+	};
+
+	std::vector<Value> values;
+
+	Value &At(size_t index);
+	const Value *Find(size_t index, cef_value_type_t type) const;
+
+public:
+	static CefRefPtr<CefListValue> Create();
+
+	inline size_t GetSize() const { return values.size(); }
+	bool SetSize(size_t size);
+	cef_value_type_t GetType(size_t index) const;
+
+	bool SetBool(size_t index, bool value);
+	bool SetInt(size_t index, int value);
+	bool SetDouble(size_t index, double value);
+	bool SetString(size_t index, const CefString &value);
+
+	bool GetBool(size_t index) const;
+	int GetInt(size_t index) const;
+	double GetDouble(size_t index) const;
+	CefString GetString(size_t index) const;
+
+	IMPLEMENT_REFCOUNTING(CefListValue);
+};
+
+class CefDictionaryValue : public virtual CefBaseRefCounted {
+	std::map<CefString, CefString> strings;
+
+public:
+	static CefRefPtr<CefDictionaryValue> Create();
+
+	bool HasKey(const CefString &key) const;
+	bool SetString(const CefString &key, const CefString &value);
+	CefString GetString(const CefString &key) const;
+
+	IMPLEMENT_REFCOUNTING(CefDictionaryValue);
+};
+
+class CefProcessMessage : public virtual CefBaseRefCounted {
+	CefString name;
+	CefRefPtr<CefListValue> args;
+
+	inline CefProcessMessage(const CefString &name_)
+		: name(name_), args(CefListValue::Create())
+	{
+	}
+
+public:
+	static CefRefPtr<CefProcessMessage> Create(const CefString &name);
+
+	inline bool IsValid() const { return true; }
+	inline CefString GetName() const { return name; }
+	inline CefRefPtr<CefListValue> GetArgumentList() const { return args; }
+
+	IMPLEMENT_REFCOUNTING(CefProcessMessage);
+};
+
+/* ========================================================================= */
+/* Tasks                                                                     */
+
+class CefTask : public virtual CefBaseRefCounted {
+public:
+	virtual void Execute() = 0;
+};
+
+extern bool CefPostTask(CefThreadId thread_id, CefRefPtr<CefTask> task);
+extern bool CefPostDelayedTask(CefThreadId thread_id, CefRefPtr<CefTask> task,
+			       int64_t delay_ms);
+
+/* ========================================================================= */
+/* Browsers                                                                  */
+
+class CefBrowser;
+class CefBrowserHost;
+class CefClient;
+class CefFrame;
+class CefRequestContext;
+
+class CefFrame : public virtual CefBaseRefCounted {
+public:
+	virtual bool IsValid() = 0;
+	virtual bool IsMain() = 0;
+	virtual CefRefPtr<CefBrowser> GetBrowser() = 0;
+	virtual void
+	SendProcessMessage(CefProcessId target_process,
+			   CefRefPtr<CefProcessMessage> message) = 0;
+};
+
+class CefBrowser : public virtual CefBaseRefCounted {
+public:
+	virtual CefRefPtr<CefBrowserHost> GetHost() = 0;
+	virtual CefRefPtr<CefFrame> GetMainFrame() = 0;
+	virtual int GetIdentifier() = 0;
+	virtual void Reload() = 0;
+	virtual void ReloadIgnoreCache() = 0;
+};
+
+class CefBrowserHost : public virtual CefBaseRefCounted {
+public:
+	typedef cef_mouse_button_type_t MouseButtonType;
+
+	/* Creates a mock browser, nothing is loaded */
+	static CefRefPtr<CefBrowser>
+	CreateBrowserSync(const CefWindowInfo &windowInfo,
+			  CefRefPtr<CefClient> client, const CefString &url,
+			  const CefBrowserSettings &settings,
+			  CefRefPtr<CefDictionaryValue> extra_info,
+			  CefRefPtr<CefRequestContext> request_context);
+
+	virtual CefRefPtr<CefBrowser> GetBrowser() = 0;
+	virtual CefRefPtr<CefClient> GetClient() = 0;
+	virtual void CloseBrowser(bool force_close) = 0;
+	virtual void WasHidden(bool hidden) = 0;
+	virtual void Invalidate(cef_paint_element_type_t type) = 0;
+	virtual void SetAudioMuted(bool mute) = 0;
+	virtual void SetWindowlessFrameRate(int frame_rate) = 0;
+	virtual void SendFocusEvent(bool setFocus) = 0;
+	virtual void SendKeyEvent(const CefKeyEvent &event) = 0;
+	virtual void SendMouseClickEvent(const CefMouseEvent &event,
+					 MouseButtonType type, bool mouseUp,
+					 int clickCount) = 0;
+	virtual void SendMouseMoveEvent(const CefMouseEvent &event,
+					bool mouseLeave) = 0;
+	virtual void SendMouseWheelEvent(const CefMouseEvent &event,
+					 int deltaX, int deltaY) = 0;
+};
+
+class CefRequestContext : public virtual CefBaseRefCounted {};
+class CefContextMenuParams : public virtual CefBaseRefCounted {};
+
+class CefMenuModel : public virtual CefBaseRefCounted {
+public:
+	virtual bool Clear() = 0;
+};
+
+/* ========================================================================= */
+/* Client handlers                                                           */
+
+class CefDisplayHandler : public virtual CefBaseRefCounted {
+public:
+	virtual bool OnConsoleMessage(CefRefPtr<CefBrowser>, cef_log_severity_t,
+				      const CefString &, const CefString &, int)
+	{
+		return false;
+	}
+	virtual bool OnTooltip(CefRefPtr<CefBrowser>, CefString &)
+	{
+		return false;
+	}
+};
+
+class CefLifeSpanHandler : public virtual CefBaseRefCounted {
+public:
+	virtual bool OnBeforePopup(CefRefPtr<CefBrowser>, CefRefPtr<CefFrame>,
+				   const CefString &, const CefString &,
+				   cef_window_open_disposition_t, bool,
+				   const CefPopupFeatures &, CefWindowInfo &,
+				   CefRefPtr<CefClient> &, CefBrowserSettings &,
+				   CefRefPtr<CefDictionaryValue> &, bool *)
+	{
+		return false;
+	}
+};
+
+class CefRequestHandler : public virtual CefBaseRefCounted {
+public:
+	typedef cef_termination_status_t TerminationStatus;
+
+	virtual void OnRenderProcessTerminated(CefRefPtr<CefBrowser>,
+					       TerminationStatus)
+	{
+	}
+};
+
+class CefContextMenuHandler : public virtual CefBaseRefCounted {
+public:
+	virtual void OnBeforeContextMenu(CefRefPtr<CefBrowser>,
+					 CefRefPtr<CefFrame>,
+					 CefRefPtr<CefContextMenuParams>,
+					 CefRefPtr<CefMenuModel>)
+	{
+	}
+};
+
+class CefRenderHandler : public virtual CefBaseRefCounted {
+public:
+	typedef cef_paint_element_type_t PaintElementType;
+	typedef std::vector<CefRect> RectList;
+
+	virtual void GetViewRect(CefRefPtr<CefBrowser> browser,
+				 CefRect &rect) = 0;
+	virtual void OnPaint(CefRefPtr<CefBrowser> browser,
+			     PaintElementType type, const RectList &dirtyRects,
+			     const void *buffer, int width, int height) = 0;
+	virtual void OnAcceleratedPaint(CefRefPtr<CefBrowser>,
+					PaintElementType, const RectList &,
+					void *)
+	{
+	}
+};
+
+/* The legacy audio stream callbacks of CEF 3770 */
+class CefAudioHandler : public virtual CefBaseRefCounted {
+public:
+	typedef cef_channel_layout_t ChannelLayout;
+
+	virtual void OnAudioStreamStarted(CefRefPtr<CefBrowser>, int, int,
+					  ChannelLayout, int, int)
+	{
+	}
+	virtual void OnAudioStreamPacket(CefRefPtr<CefBrowser>, int,
+					 const float **, int, int64_t)
+	{
+	}
+	virtual void OnAudioStreamStopped(CefRefPtr<CefBrowser>, int) {}
+};
+
+class CefClient : public virtual CefBaseRefCounted {
+public:
+	virtual CefRefPtr<CefAudioHandler> GetAudioHandler() { return nullptr; }
+	virtual CefRefPtr<CefContextMenuHandler> GetContextMenuHandler()
+	{
+		return nullptr;
+	}
+	virtual CefRefPtr<CefDisplayHandler> GetDisplayHandler()
+	{
+		return nullptr;
+	}
+	virtual CefRefPtr<CefLifeSpanHandler> GetLifeSpanHandler()
+	{
+		return nullptr;
+	}
+	virtual CefRefPtr<CefRenderHandler> GetRenderHandler()
+	{
+		return nullptr;
+	}
+	virtual CefRefPtr<CefRequestHandler> GetRequestHandler()
+	{
+		return nullptr;
+	}
+	virtual bool OnProcessMessageReceived(CefRefPtr<CefBrowser>,
+					      CefRefPtr<CefFrame>, CefProcessId,
+					      CefRefPtr<CefProcessMessage>)
+	{
+		return false;
+	}
+};
+
+/* ========================================================================= */
+/* Application handlers, only declared by the plugin (browser-app.hpp)      */
+
+class CefCommandLine : public virtual CefBaseRefCounted {
+public:
+	virtual bool HasSwitch(const CefString &name) = 0;
+	virtual CefString GetSwitchValue(const CefString &name) = 0;
+	virtual void AppendSwitch(const CefString &name) = 0;
+	virtual void AppendSwitchWithValue(const CefString &name,
+					   const CefString &value) = 0;
+};
+
+class CefSchemeRegistrar {
+public:
+	virtual ~CefSchemeRegistrar() {}
+	virtual bool AddCustomScheme(const CefString &scheme_name,
+				     int options) = 0;
+};
+
+class CefV8Value : public virtual CefBaseRefCounted {};
+class CefV8Context : public virtual CefBaseRefCounted {};
+typedef std::vector<CefRefPtr<CefV8Value>> CefV8ValueList;
+
+class CefV8Handler : public virtual CefBaseRefCounted {
+public:
+	virtual bool Execute(const CefString &name,
+			     CefRefPtr<CefV8Value> object,
+			     const CefV8ValueList &arguments,
+			     CefRefPtr<CefV8Value> &retval,
+			     CefString &exception) = 0;
+};
+
+class CefRenderProcessHandler : public virtual CefBaseRefCounted {
+public:
+	virtual void OnBrowserCreated(CefRefPtr<CefBrowser>,
+				      CefRefPtr<CefDictionaryValue>)
+	{
+	}
+	virtual void OnBrowserDestroyed(CefRefPtr<CefBrowser>) {}
+	virtual void OnContextCreated(CefRefPtr<CefBrowser>,
+				      CefRefPtr<CefFrame>,
+				      CefRefPtr<CefV8Context>)
+	{
+	}
+	virtual void OnContextReleased(CefRefPtr<CefBrowser>,
+				       CefRefPtr<CefFrame>,
+				       CefRefPtr<CefV8Context>)
+	{
+	}
+	virtual bool OnProcessMessageReceived(CefRefPtr<CefBrowser>,
+					      CefRefPtr<CefFrame>, CefProcessId,
+					      CefRefPtr<CefProcessMessage>)
+	{
+		return false;
+	}
+};
+
+class CefBrowserProcessHandler : public virtual CefBaseRefCounted {
+public:
+	virtual void OnBeforeChildProcessLaunch(CefRefPtr<CefCommandLine>) {}
+};
+
+class CefApp : public virtual CefBaseRefCounted {
+public:
+	virtual void OnBeforeCommandLineProcessing(const CefString &,
+						   CefRefPtr<CefCommandLine>)
+	{
+	}
+	virtual void OnRegisterCustomSchemes(CefRawPtr<CefSchemeRegistrar>) {}
+	virtual CefRefPtr<CefBrowserProcessHandler> GetBrowserProcessHandler()
+	{
+		return nullptr;
+	}
+	virtual CefRefPtr<CefRenderProcessHandler> GetRenderProcessHandler()
+	{
+		return nullptr;
+	}
+};
+
+/* ========================================================================= */
+/* Mock controls, for the code driving the plugin                            */
+
+/* Runs the tasks posted to any CEF thread on the calling thread, in the
+ * order they were posted and delayed ones without the delay, until none
+ * are left.  Returns the number of tasks run. */
+extern size_t MockCefRunTasks();
+
+/* Process messages sent through the mock frames, and the bytes they were
+ * encoded to */
+extern std::atomic<uint64_t> mock_cef_messages;
+extern std::atomic<uint64_t> mock_cef_message_bytes;
@@ -0,0 +1,368 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/* Microbenchmarks of the plugin side of the browser source hot paths:
+ * settings updates, JS event fan-out, renderer messages and the audio mix.
+ *
+ * The plugin sources are built against the mock CEF in mock-cef.hpp, so
+ * this runs without Chromium, a GPU or the OBS UI.  libobs is started
+ * without video or audio, graphics calls go to the obs-browser-bench stubs
+ * and the frontend to obs-browser-microbench-stubs.cpp.  Tasks the plugin
+ * queues for the CEF UI thread run on the benchmark thread, inside the
+ * timed loop where the path being measured includes them.
+ *
+ *   obs-browser-microbench [--benchmark_filter=regex]
+ *                          [--benchmark_format=json] [...]
+ */
+
+#include <obs-module.h>
+#include <util/base.h>
+#include <util/platform.h>
+#include <benchmark/benchmark.h>
+#include "obs-browser-source.hpp"
+#include "browser-task-monitor.hpp"
+#include "browser-trace.hpp"
+#include "json11/json11.hpp"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+using namespace json11;
+
+/* Not loaded as a module: no config directory, module text is its key */
+OBS_DECLARE_MODULE()
+OBS_MODULE_USE_DEFAULT_LOCALE("obs-browser", "en-US")
+
+extern void DispatchJSEvent(std::string eventName, std::string jsonString,
+			    BrowserSource *browser = nullptr);
+extern void ClearTexturePool();
+extern obs_source_t *MockAudioSourceCreate(uint64_t timestamp,
+					   size_t channels, size_t frames);
+extern void MockAudioSourceDestroy(obs_source_t *source);
+
+/* ========================================================================= */
+
+/* What obs-browser-plugin.cpp provides to the sources in OBS */
+
+bool hwaccel = false;
+
+class BrowserTask : public CefTask {
+public:
+	std::function<void()> task;
+
+	inline BrowserTask(std::function<void()> task_) : task(task_) {}
+	virtual void Execute() override { task(); }
+
+	IMPLEMENT_REFCOUNTING(BrowserTask);
+};
+
+bool QueueCEFTask(std::function<void()> task, TaskCategory category)
+{
+	TRACE_SCOPE("QueueCEFTask");
+
+	uint64_t flow = TraceFlowStart("CEF task");
+	uint64_t queued_ts = os_gettime_ns();
+	std::function<void()> wrapped = [task, category, flow, queued_ts]() {
+		TaskMonitorScope scope(category, queued_ts);
+		TraceThreadName("CEF UI");
+		TRACE_SCOPE("CEF task");
+		TraceFlowEnd("CEF task", flow);
+		task();
+	};
+
+	return CefPostTask(TID_UI,
+			   CefRefPtr<BrowserTask>(new BrowserTask(wrapped)));
+}
+
+static void RegisterMicrobenchSource()
+{
+	struct obs_source_info info = {};
+	info.id = "browser_source";
+	info.type = OBS_SOURCE_TYPE_INPUT;
+	info.output_flags = OBS_SOURCE_VIDEO | OBS_SOURCE_CUSTOM_DRAW;
+
+	info.get_name = [](void *) { return "Browser"; };
+	info.create = [](obs_data_t *settings, obs_source_t *source) -> void * {
+		return new BrowserSource(settings, source);
+	};
+	info.destroy = [](void *data) {
+		static_cast<BrowserSource *>(data)->Destroy();
+	};
+	info.update = [](void *data, obs_data_t *settings) {
+		static_cast<BrowserSource *>(data)->Update(settings);
+	};
+
+	obs_register_source(&info);
+}
+
+/* ========================================================================= */
+
+static obs_data_t *GetSettings(const char *url, int control_level)
+{
+	obs_data_t *settings = obs_data_create();
+	obs_data_set_string(settings, "url", url);
+	obs_data_set_int(settings, "width", 1920);
+	obs_data_set_int(settings, "height", 1080);
+	obs_data_set_bool(settings, "fps_custom", true);
+	obs_data_set_int(settings, "fps", 30);
+	obs_data_set_bool(settings, "reroute_audio", true);
+	obs_data_set_int(settings, "webpage_control_level", control_level);
+	obs_data_set_int(settings, "asset_cache",
+			 (int)DEFAULT_ASSET_CACHE_POLICY);
+	obs_data_set_string(settings, "css",
+			    "body { background-color: rgba(0, 0, 0, 0); "
+			    "margin: 0px auto; overflow: hidden; }");
+	return settings;
+}
+
+/* Browser sources with a (mock) browser each, destroyed with the fixture */
+class Sources {
+	std::vector<obs_source_t *> sources;
+
+public:
+	std::vector<BrowserSource *> bs;
+
+	Sources(int count, int control_level = (int)DEFAULT_CONTROL_LEVEL)
+	{
+		obs_data_t *settings =
+			GetSettings("https://example.com/", control_level);
+
+		for (int i = 0; i < count; i++) {
+			std::string name = "browser " + std::to_string(i + 1);
+			obs_source_t *source = obs_source_create_private(
+				"browser_source", name.c_str(), settings);
+			if (!source)
+				continue;
+
+			BrowserSource *b = static_cast<BrowserSource *>(
+				obs_obj_get_data(source));
+
+			/* what the deferred update and Tick do in OBS */
+			b->Update(settings);
+			b->CreateBrowser();
+
+			sources.push_back(source);
+			bs.push_back(b);
+		}
+
+		obs_data_release(settings);
+		MockCefRunTasks();
+	}
+
+	~Sources()
+	{
+		for (obs_source_t *source : sources)
+			obs_source_release(source);
+		MockCefRunTasks();
+	}
+};
+
+static void SetMessageCounters(benchmark::State &state, uint64_t messages,
+			       uint64_t bytes)
+{
+	messages = mock_cef_messages - messages;
+	bytes = mock_cef_message_bytes - bytes;
+
+	state.counters["messages"] = benchmark::Counter(
+		(double)messages, benchmark::Counter::kIsRate);
+	state.counters["bytes_per_message"] =
+		messages ? (double)bytes / (double)messages : 0.0;
+}
+
+/* ========================================================================= */
+
+/* Update with the settings the source already has, as OBS calls it for
+ * every change in the properties dialog */
+static void BM_UpdateUnchanged(benchmark::State &state)
+{
+	Sources fixture(1);
+	BrowserSource *bs = fixture.bs[0];
+	obs_data_t *settings = GetSettings("https://example.com/",
+					   (int)DEFAULT_CONTROL_LEVEL);
+
+	for (auto _ : state)
+		bs->Update(settings);
+
+	obs_data_release(settings);
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UpdateUnchanged);
+
+/* Update with a new URL, which tears down the browser for Tick to
+ * recreate */
+static void BM_UpdateChanged(benchmark::State &state)
+{
+	Sources fixture(1);
+	BrowserSource *bs = fixture.bs[0];
+	const int level = (int)DEFAULT_CONTROL_LEVEL;
+	obs_data_t *settings[2] = {
+		GetSettings("https://example.com/a", level),
+		GetSettings("https://example.com/b", level),
+	};
+	size_t i = 0;
+
+	for (auto _ : state) {
+		bs->Update(settings[i++ & 1]);
+		MockCefRunTasks();
+	}
+
+	obs_data_release(settings[0]);
+	obs_data_release(settings[1]);
+	state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_UpdateChanged);
+
+/* ------------------------------------------------------------------------- */
+
+/* One event to every source, as the frontend event handler sends them,
+ * up to the process messages leaving for the renderers.  Arguments are
+ * the number of sources and the size of the JSON payload. */
+static void BM_DispatchJSEvent(benchmark::State &state)
+{
+	Sources fixture((int)state.range(0));
+	Json json = Json::object{
+		{"name", "Scene"},
+		{"data", std::string((size_t)state.range(1), 'x')},
+	};
+	const std::string payload = json.dump();
+
+	const uint64_t messages = mock_cef_messages;
+	const uint64_t bytes = mock_cef_message_bytes;
+
+	for (auto _ : state) {
+		DispatchJSEvent("obsSceneChanged", payload);
+		MockCefRunTasks();
+	}
+
+	state.SetItemsProcessed(state.iterations() * state.range(0));
+	SetMessageCounters(state, messages, bytes);
+}
+BENCHMARK(BM_DispatchJSEvent)->ArgsProduct({{1, 8, 64}, {64, 4096}});
+
+/* ------------------------------------------------------------------------- */
+
+/* A message from the page, handled by the browser client down to the
+ * reply sent back to the renderer */
+static void BM_ProcessMessage(benchmark::State &state, const char *name)
+{
+	Sources fixture(1, (int)ControlLevel::ReadUser);
+	CefRefPtr<CefBrowser> browser = fixture.bs[0]->GetBrowser();
+	CefRefPtr<CefClient> client = browser->GetHost()->GetClient();
+	CefRefPtr<CefFrame> frame = browser->GetMainFrame();
+
+	const uint64_t messages = mock_cef_messages;
+	const uint64_t bytes = mock_cef_message_bytes;
+	int id = 0;
+
+	for (auto _ : state) {
+		/* a new message each time, like the ones IPC hands over */
+		CefRefPtr<CefProcessMessage> msg =
+			CefProcessMessage::Create(name);
+		msg->GetArgumentList()->SetInt(0, ++id);
+
+		client->OnProcessMessageReceived(browser, frame, PID_RENDERER,
+						 msg);
+	}
+
+	state.SetItemsProcessed(state.iterations());
+	SetMessageCounters(state, messages, bytes);
+}
+BENCHMARK_CAPTURE(BM_ProcessMessage, Pong, "Pong");
+BENCHMARK_CAPTURE(BM_ProcessMessage, getControlLevel, "getControlLevel");
+BENCHMARK_CAPTURE(BM_ProcessMessage, getStatus, "getStatus");
+BENCHMARK_CAPTURE(BM_ProcessMessage, getScenes, "getScenes");
+
+/* ------------------------------------------------------------------------- */
+
+#define MIX_SAMPLE_RATE 48000
+
+/* One audio tick of the source's mix of its audio streams.  Arguments are
+ * the number of streams and of channels.  The streams start a few samples
+ * apart, so every one but the first is mixed in at an offset. */
+static void BM_AudioMix(benchmark::State &state)
+{
+	Sources fixture(1);
+	BrowserSource *bs = fixture.bs[0];
+	const int streams = (int)state.range(0);
+	const size_t channels = (size_t)state.range(1);
+	const uint64_t start = 1000000000ULL;
+
+	{
+		std::lock_guard<std::mutex> lock(bs->audio_sources_mutex);
+		for (int i = 0; i < streams; i++)
+			bs->audio_sources.push_back(MockAudioSourceCreate(
+				start + (uint64_t)i * 100000ULL, channels,
+				AUDIO_OUTPUT_FRAMES));
+	}
+
+	std::vector<float> out(channels * AUDIO_OUTPUT_FRAMES);
+	struct audio_output_data mix = {};
+	for (size_t ch = 0; ch < channels; ch++)
+		mix.data[ch] = &out[ch * AUDIO_OUTPUT_FRAMES];
+
+	for (auto _ : state) {
+		uint64_t ts = 0;
+		bs->AudioMix(&ts, &mix, channels, MIX_SAMPLE_RATE);
+		benchmark::DoNotOptimize(ts);
+		benchmark::ClobberMemory();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(bs->audio_sources_mutex);
+		for (obs_source_t *source : bs->audio_sources)
+			MockAudioSourceDestroy(source);
+		bs->audio_sources.clear();
+	}
+
+	state.SetItemsProcessed(state.iterations() * streams *
+				AUDIO_OUTPUT_FRAMES);
+}
+BENCHMARK(BM_AudioMix)->ArgsProduct({{1, 4, 16}, {2, 6}});
+
+/* ========================================================================= */
+
+/* results go to stdout, only problems to stderr */
+static void LogHandler(int level, const char *format, va_list args, void *)
+{
+	if (level > LOG_WARNING)
+		return;
+
+	vfprintf(stderr, format, args);
+	fputc('\n', stderr);
+}
+
+int main(int argc, char *argv[])
+{
+	benchmark::Initialize(&argc, argv);
+	if (benchmark::ReportUnrecognizedArguments(argc, argv))
+		return 1;
+
+	base_set_log_handler(LogHandler, nullptr);
+
+	if (!obs_startup("en-US", nullptr, nullptr)) {
+		fprintf(stderr, "Failed to start libobs\n");
+		return 1;
+	}
+	RegisterMicrobenchSource();
+
+	benchmark::RunSpecifiedBenchmarks();
+	benchmark::Shutdown();
+
+	MockCefRunTasks();
+	ClearTexturePool();
+	obs_shutdown();
+	return 0;
+}
@@ -0,0 +1,160 @@
+/******************************************************************************
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 2 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ ******************************************************************************/
+
+/* Stub OBS frontend and audio children for obs-browser-microbench.
+ *
+ * There is no OBS UI, so the frontend calls pages can make answer like an
+ * idle OBS: no scenes, nothing recording or streaming.  Audio children are
+ * plain buffers: libobs only fills in the mix of a real audio source from
+ * its audio thread, which the microbench doesn't run.  The functions
+ * AudioMix reads a child through take the place of libobs' ones. */
+
+#include <obs.h>
+#include <obs-frontend-api.h>
+#include <string.h>
+#include <vector>
+
+/* ========================================================================= */
+
+void obs_frontend_get_scenes(struct obs_frontend_source_list *sources)
+{
+	UNUSED_PARAMETER(sources);
+}
+
+obs_source_t *obs_frontend_get_current_scene(void)
+{
+	return nullptr;
+}
+
+void obs_frontend_set_current_scene(obs_source_t *scene)
+{
+	UNUSED_PARAMETER(scene);
+}
+
+void obs_frontend_get_transitions(struct obs_frontend_source_list *sources)
+{
+	UNUSED_PARAMETER(sources);
+}
+
+obs_source_t *obs_frontend_get_current_transition(void)
+{
+	return nullptr;
+}
+
+void obs_frontend_set_current_transition(obs_source_t *transition)
+{
+	UNUSED_PARAMETER(transition);
+}
+
+void obs_frontend_streaming_start(void) {}
+
+void obs_frontend_streaming_stop(void) {}
+
+bool obs_frontend_streaming_active(void)
+{
+	return false;
+}
+
+void obs_frontend_recording_start(void) {}
+
+void obs_frontend_recording_stop(void) {}
+
+bool obs_frontend_recording_active(void)
+{
+	return false;
+}
+
+void obs_frontend_recording_pause(bool pause)
+{
+	UNUSED_PARAMETER(pause);
+}
+
+bool obs_frontend_recording_paused(void)
+{
+	return false;
+}
+
+void obs_frontend_replay_buffer_start(void) {}
+
+void obs_frontend_replay_buffer_save(void) {}
+
+void obs_frontend_replay_buffer_stop(void) {}
+
+bool obs_frontend_replay_buffer_active(void)
+{
+	return false;
+}
+
+void obs_frontend_start_virtualcam(void) {}
+
+void obs_frontend_stop_virtualcam(void) {}
+
+bool obs_frontend_virtualcam_active(void)
+{
+	return false;
+}
+
+/* ========================================================================= */
+
+struct MockAudioSource {
+	uint64_t timestamp;
+	std::vector<float> data;
+	struct obs_source_audio_mix mix;
+};
+
+static inline const MockAudioSource *GetMock(const obs_source_t *source)
+{
+	return reinterpret_cast<const MockAudioSource *>(source);
+}
+
+/* A child with a mix of |channels| channels of |frames| frames each,
+ * starting at |timestamp| */
+obs_source_t *MockAudioSourceCreate(uint64_t timestamp, size_t channels,
+				    size_t frames)
+{
+	MockAudioSource *mock = new MockAudioSource;
+	mock->timestamp = timestamp;
+	mock->data.resize(channels * frames);
+	memset(&mock->mix, 0, sizeof(mock->mix));
+
+	for (size_t i = 0; i < mock->data.size(); i++)
+		mock->data[i] = (float)(i % frames) / (float)frames - 0.5f;
+	for (size_t ch = 0; ch < channels; ch++)
+		mock->mix.output[0].data[ch] = &mock->data[ch * frames];
+
+	return reinterpret_cast<obs_source_t *>(mock);
+}
+
+void MockAudioSourceDestroy(obs_source_t *source)
+{
+	delete reinterpret_cast<MockAudioSource *>(source);
+}
+
+bool obs_source_audio_pending(const obs_source_t *source)
+{
+	UNUSED_PARAMETER(source);
+	return false;
+}
+
+uint64_t obs_source_get_audio_timestamp(const obs_source_t *source)
+{
+	return GetMock(source)->timestamp;
+}
+
+void obs_source_get_audio_mix(const obs_source_t *source,
+			      struct obs_source_audio_mix *audio)
+{
+	*audio = GetMock(source)->mix;
+}
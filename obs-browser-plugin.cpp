@@ -23,14 +23,19 @@
 #include <util/dstr.hpp>
 #include <obs-module.h>
 #include <obs.hpp>
+#include <algorithm>
 #include <functional>
 #include <sstream>
 #include <thread>
 #include <mutex>
+#include <vector>
+#include <inttypes.h>
 
 #include "obs-browser-source.hpp"
 #include "browser-scheme.hpp"
 #include "browser-app.hpp"
+#include "browser-trace.hpp"
+#include "browser-task-monitor.hpp"
 #include "browser-version.h"
 #include "browser-config.h"
 
@@ -63,6 +68,9 @@ static thread manager_thread;
 static bool manager_initialized = false;
 os_event_t *cef_started_event = nullptr;
 
+static std::mutex cef_started_mutex;
+static std::vector<std::function<void()>> cef_started_callbacks;
+
 #if defined(_WIN32)
 static int adapterCount = 0;
 #endif
@@ -98,10 +106,37 @@ public:
 	IMPLEMENT_REFCOUNTING(BrowserTask);
 };
 
-bool QueueCEFTask(std::function<void()> task)
+bool QueueCEFTask(std::function<void()> task, TaskCategory category)
 {
+	TRACE_SCOPE("QueueCEFTask");
+
+	uint64_t flow = TraceFlowStart("CEF task");
+	uint64_t queued_ts = os_gettime_ns();
+	std::function<void()> wrapped = [task, category, flow, queued_ts]() {
+		TaskMonitorScope scope(category, queued_ts);
+		TraceThreadName("CEF UI");
+		TRACE_SCOPE("CEF task");
+		TraceFlowEnd("CEF task", flow);
+		task();
+	};
+
 	return CefPostTask(TID_UI,
-			   CefRefPtr<BrowserTask>(new BrowserTask(task)));
+			   CefRefPtr<BrowserTask>(new BrowserTask(wrapped)));
+}
+
+/* Calls |callback| once CEF has started, right away if it already has.
+ * Pending callbacks run on the thread that initialized CEF. */
+void OnCEFStarted(std::function<void()> callback)
+{
+	{
+		std::lock_guard<std::mutex> lock(cef_started_mutex);
+		if (os_event_try(cef_started_event) != 0) {
+			cef_started_callbacks.push_back(std::move(callback));
+			return;
+		}
+	}
+
+	callback();
 }
 
 /* ========================================================================= */
@@ -127,10 +162,20 @@ static void browser_source_get_defaults(obs_data_t *settings)
 #endif
 	obs_data_set_default_bool(settings, "shutdown", false);
 	obs_data_set_default_bool(settings, "restart_when_active", false);
+	obs_data_set_default_int(settings, "memory_limit", 0);
+	obs_data_set_default_int(settings, "memory_limit_action",
+				 (int)MemoryLimitAction::Refresh);
+	obs_data_set_default_bool(settings, "memory_limit_inactive", true);
 	obs_data_set_default_int(settings, "webpage_control_level",
 				 (int)DEFAULT_CONTROL_LEVEL);
+	obs_data_set_default_int(settings, "asset_cache",
+				 (int)DEFAULT_ASSET_CACHE_POLICY);
 	obs_data_set_default_string(settings, "css", default_css);
+	obs_data_set_default_string(settings, "request_rules", "");
+	obs_data_set_default_string(settings, "bundle_file", "");
 	obs_data_set_default_bool(settings, "reroute_audio", false);
+	obs_data_set_default_bool(settings, "sync_av", false);
+	obs_data_set_default_int(settings, "sync_av_offset", 0);
 }
 
 static bool is_local_file_modified(obs_properties_t *props, obs_property_t *,
@@ -145,16 +190,104 @@ static bool is_local_file_modified(obs_properties_t *props, obs_property_t *,
 	return true;
 }
 
+/* The delay line is bounded in memory, so large sources at high frame rates
+ * can't delay video by a full second.  The bound follows the size and frame
+ * rate being edited rather than those of the running browser. */
+static void update_sync_av_limit(obs_properties_t *props,
+				 obs_data_t *settings)
+{
+	obs_property_t *offset = obs_properties_get(props, "sync_av_offset");
+	int cx = (int)obs_data_get_int(settings, "width");
+	int cy = (int)obs_data_get_int(settings, "height");
+	double fps = obs_data_get_bool(settings, "fps_custom")
+			     ? (double)obs_data_get_int(settings, "fps")
+			     : GetCanvasFrameRate();
+	int max_offset = std::min(GetMaxSyncOffset(cx, cy, fps), 1000);
+
+	obs_property_int_set_limits(offset, -1000, max_offset, 1);
+
+	if (max_offset < 1000) {
+		char text[256];
+		snprintf(text, sizeof(text),
+			 obs_module_text("SyncOffset.Limit"), max_offset);
+		obs_property_set_long_description(offset, text);
+	} else {
+		obs_property_set_long_description(offset, nullptr);
+	}
+}
+
 static bool is_fps_custom(obs_properties_t *props, obs_property_t *,
 			  obs_data_t *settings)
 {
 	bool enabled = obs_data_get_bool(settings, "fps_custom");
 	obs_property_t *fps = obs_properties_get(props, "fps");
 	obs_property_set_visible(fps, enabled);
+	update_sync_av_limit(props, settings);
 
 	return true;
 }
 
+static bool is_sync_av_modified(obs_properties_t *props, obs_property_t *,
+				obs_data_t *settings)
+{
+	bool enabled = obs_data_get_bool(settings, "sync_av");
+	obs_property_t *offset = obs_properties_get(props, "sync_av_offset");
+	obs_property_set_visible(offset, enabled);
+	update_sync_av_limit(props, settings);
+
+	return true;
+}
+
+static bool is_sync_av_bound_modified(obs_properties_t *props,
+				      obs_property_t *, obs_data_t *settings)
+{
+	update_sync_av_limit(props, settings);
+	return true;
+}
+
+static std::string GetStatsText(BrowserSource *bs)
+{
+	const BrowserStats &stats = bs->stats;
+	uint64_t paints = stats.paints;
+	uint64_t upload_ms = stats.upload_ns / 1000000;
+	uint64_t wait_ms = stats.graphics_wait_ns / 1000000;
+	char text[1024];
+
+	snprintf(text, sizeof(text),
+		 "%s: %.1f fps\n"
+		 "%s: %" PRIu64 " (%" PRIu64 " %s)\n"
+		 "%s: %.1f MB, %" PRIu64 " ms\n"
+		 "%s: %" PRIu64 " ms\n"
+		 "%s: %" PRIu64 " / %" PRIu64 "\n"
+		 "%s: %" PRIu64 " (%" PRIu64 " %s)\n"
+		 "%s: %.2f / %.2f ms\n"
+		 "%s: %.2f / %.2f ms\n"
+		 "%s: %d, %.1f MB (%.1f MB %s), %.1f%% CPU",
+		 obs_module_text("Stats.PaintRate"), stats.paint_rate.load(),
+		 obs_module_text("Stats.Paints"), paints,
+		 (uint64_t)stats.skipped_frames,
+		 obs_module_text("Stats.Skipped"),
+		 obs_module_text("Stats.Upload"),
+		 (double)stats.upload_bytes / (1024.0 * 1024.0), upload_ms,
+		 obs_module_text("Stats.GraphicsWait"), wait_ms,
+		 obs_module_text("Stats.IPC"), (uint64_t)stats.ipc_in,
+		 (uint64_t)stats.ipc_out, obs_module_text("Stats.Audio"),
+		 (uint64_t)stats.audio_packets,
+		 (uint64_t)stats.audio_underruns,
+		 obs_module_text("Stats.Underruns"),
+		 obs_module_text("Stats.RoundTrip"),
+		 (double)stats.ipc_rtt.Percentile(0.5) / 1000.0,
+		 (double)stats.ipc_rtt.Percentile(0.99) / 1000.0,
+		 obs_module_text("Stats.FrameAge"),
+		 (double)stats.frame_age.Percentile(0.5) / 1000.0,
+		 (double)stats.frame_age.Percentile(0.99) / 1000.0,
+		 obs_module_text("Stats.Renderer"), stats.renderer_pid.load(),
+		 (double)stats.renderer_rss / (1024.0 * 1024.0),
+		 (double)stats.renderer_rss_peak / (1024.0 * 1024.0),
+		 obs_module_text("Stats.Peak"), stats.renderer_cpu.load());
+	return text;
+}
+
 static obs_properties_t *browser_source_get_properties(void *data)
 {
 	obs_properties_t *props = obs_properties_create();
@@ -182,10 +315,12 @@ static obs_properties_t *browser_source_get_properties(void *data)
 	obs_properties_add_text(props, "url", obs_module_text("URL"),
 				OBS_TEXT_DEFAULT);
 
-	obs_properties_add_int(props, "width", obs_module_text("Width"), 1,
-			       4096, 1);
-	obs_properties_add_int(props, "height", obs_module_text("Height"), 1,
-			       4096, 1);
+	prop = obs_properties_add_int(props, "width", obs_module_text("Width"),
+				      1, 4096, 1);
+	obs_property_set_modified_callback(prop, is_sync_av_bound_modified);
+	prop = obs_properties_add_int(props, "height",
+				      obs_module_text("Height"), 1, 4096, 1);
+	obs_property_set_modified_callback(prop, is_sync_av_bound_modified);
 
 	obs_property_t *fps_set = obs_properties_add_bool(
 		props, "fps_custom", obs_module_text("CustomFrameRate"));
@@ -198,7 +333,17 @@ static obs_properties_t *browser_source_get_properties(void *data)
 	obs_properties_add_bool(props, "reroute_audio",
 				obs_module_text("RerouteAudio"));
 
-	obs_properties_add_int(props, "fps", obs_module_text("FPS"), 1, 60, 1);
+	obs_property_t *sync_av = obs_properties_add_bool(
+		props, "sync_av", obs_module_text("SyncAudioToVideo"));
+	obs_property_set_modified_callback(sync_av, is_sync_av_modified);
+	obs_property_t *sync_av_offset = obs_properties_add_int(
+		props, "sync_av_offset", obs_module_text("SyncOffset"), -1000,
+		1000, 1);
+	obs_property_int_set_suffix(sync_av_offset, " ms");
+
+	prop = obs_properties_add_int(props, "fps", obs_module_text("FPS"), 1,
+				      60, 1);
+	obs_property_set_modified_callback(prop, is_sync_av_bound_modified);
 	obs_property_t *p = obs_properties_add_text(
 		props, "css", obs_module_text("CSS"), OBS_TEXT_MULTILINE);
 	obs_property_text_set_monospace(p, true);
@@ -207,6 +352,30 @@ static obs_properties_t *browser_source_get_properties(void *data)
 	obs_properties_add_bool(props, "restart_when_active",
 				obs_module_text("RefreshBrowserActive"));
 
+#ifdef __linux__
+	/* renderer memory is only sampled on Linux */
+	p = obs_properties_add_int(props, "memory_limit",
+				   obs_module_text("MemoryLimit"), 0, 65536,
+				   64);
+	obs_property_int_set_suffix(p, " MB");
+	obs_property_set_long_description(
+		p, obs_module_text("MemoryLimit.Description"));
+
+	obs_property_t *memoryAction = obs_properties_add_list(
+		props, "memory_limit_action",
+		obs_module_text("MemoryLimit.Action"), OBS_COMBO_TYPE_LIST,
+		OBS_COMBO_FORMAT_INT);
+	obs_property_list_add_int(memoryAction,
+				  obs_module_text("MemoryLimit.Action.Refresh"),
+				  (int)MemoryLimitAction::Refresh);
+	obs_property_list_add_int(
+		memoryAction, obs_module_text("MemoryLimit.Action.Recreate"),
+		(int)MemoryLimitAction::Recreate);
+
+	obs_properties_add_bool(props, "memory_limit_inactive",
+				obs_module_text("MemoryLimit.Inactive"));
+#endif
+
 	obs_property_t *controlLevel = obs_properties_add_list(
 		props, "webpage_control_level",
 		obs_module_text("WebpageControlLevel"), OBS_COMBO_TYPE_LIST,
@@ -235,12 +404,67 @@ static obs_properties_t *browser_source_get_properties(void *data)
 		controlLevel, obs_module_text("WebpageControlLevel.Level.All"),
 		(int)ControlLevel::All);
 
+#if CHROME_VERSION_BUILD >= 4638
+	obs_property_t *assetCache = obs_properties_add_list(
+		props, "asset_cache", obs_module_text("AssetCache"),
+		OBS_COMBO_TYPE_LIST, OBS_COMBO_FORMAT_INT);
+
+	obs_property_list_add_int(assetCache,
+				  obs_module_text("AssetCache.Disabled"),
+				  (int)AssetCachePolicy::Disabled);
+	obs_property_list_add_int(assetCache,
+				  obs_module_text("AssetCache.Immutable"),
+				  (int)AssetCachePolicy::Immutable);
+	obs_property_list_add_int(
+		assetCache, obs_module_text("AssetCache.ImmutableAndHashed"),
+		(int)AssetCachePolicy::ImmutableAndHashed);
+
+	p = obs_properties_add_text(props, "request_rules",
+				    obs_module_text("RequestRules"),
+				    OBS_TEXT_MULTILINE);
+	obs_property_text_set_monospace(p, true);
+	obs_property_set_long_description(
+		p, obs_module_text("RequestRules.Description"));
+
+	p = obs_properties_add_path(props, "bundle_file",
+				    obs_module_text("BundleFile"),
+				    OBS_PATH_FILE,
+				    "Zip (*.zip);;All files (*.*)", nullptr);
+	obs_property_set_long_description(
+		p, obs_module_text("BundleFile.Description"));
+#endif
+
 	obs_properties_add_button(
 		props, "refreshnocache", obs_module_text("RefreshNoCache"),
 		[](obs_properties_t *, obs_property_t *, void *data) {
 			static_cast<BrowserSource *>(data)->Refresh();
 			return false;
 		});
+
+	if (bs) {
+		obs_properties_t *group = obs_properties_create();
+		p = obs_properties_add_text(group, "stats", "",
+					    OBS_TEXT_INFO);
+		obs_property_set_description(p, GetStatsText(bs).c_str());
+
+		obs_properties_add_button(
+			group, "refresh_stats",
+			obs_module_text("Stats.Refresh"),
+			[](obs_properties_t *props, obs_property_t *,
+			   void *data) {
+				BrowserSource *bs =
+					static_cast<BrowserSource *>(data);
+				obs_property_t *p =
+					obs_properties_get(props, "stats");
+				obs_property_set_description(
+					p, GetStatsText(bs).c_str());
+				return true;
+			});
+
+		obs_properties_add_group(props, "stats_group",
+					 obs_module_text("Stats"),
+					 OBS_GROUP_NORMAL, group);
+	}
 	return props;
 }
 
@@ -259,6 +483,22 @@ static void missing_file_callback(void *src, const char *new_path, void *data)
 	UNUSED_PARAMETER(data);
 }
 
+static void missing_bundle_callback(void *src, const char *new_path,
+				    void *data)
+{
+	BrowserSource *bs = static_cast<BrowserSource *>(src);
+
+	if (bs) {
+		obs_source_t *source = bs->source;
+		obs_data_t *settings = obs_source_get_settings(source);
+		obs_data_set_string(settings, "bundle_file", new_path);
+		obs_source_update(source, settings);
+		obs_data_release(settings);
+	}
+
+	UNUSED_PARAMETER(data);
+}
+
 static obs_missing_files_t *browser_source_missingfiles(void *data)
 {
 	BrowserSource *bs = static_cast<BrowserSource *>(data);
@@ -283,6 +523,16 @@ static obs_missing_files_t *browser_source_missingfiles(void *data)
 			}
 		}
 
+		const char *bundle =
+			obs_data_get_string(settings, "bundle_file");
+		if (*bundle && !os_file_exists(bundle)) {
+			obs_missing_file_t *file = obs_missing_file_create(
+				bundle, missing_bundle_callback,
+				OBS_MISSING_FILE_SOURCE, bs->source, NULL);
+
+			obs_missing_files_add_file(files, file);
+		}
+
 		obs_data_release(settings);
 	}
 
@@ -401,7 +651,16 @@ static void BrowserInit(void)
 	CefRegisterSchemeHandlerFactory("http", "absolute",
 					new BrowserSchemeHandlerFactory());
 #endif
-	os_event_signal(cef_started_event);
+
+	std::vector<std::function<void()>> callbacks;
+	{
+		std::lock_guard<std::mutex> lock(cef_started_mutex);
+		os_event_signal(cef_started_event);
+		callbacks.swap(cef_started_callbacks);
+	}
+
+	for (auto &callback : callbacks)
+		callback();
 }
 
 static void BrowserShutdown(void)
@@ -424,9 +683,68 @@ static void BrowserManagerThread(void)
 }
 #endif
 
+/* Returns the source's performance counters as a JSON object, free with
+ * bfree */
+extern "C" EXPORT char *obs_browser_source_get_stats(obs_source_t *source)
+{
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	calldata_t cd = {};
+	const char *json = nullptr;
+	char *result = nullptr;
+
+	if (proc_handler_call(ph, "get_stats", &cd) &&
+	    calldata_get_string(&cd, "json", &json))
+		result = bstrdup(json);
+
+	calldata_free(&cd);
+	return result;
+}
+
+extern "C" EXPORT void obs_browser_trace_start(void)
+{
+	TraceStart();
+}
+
+/* Stops tracing and writes the Chrome trace JSON to |path| */
+extern "C" EXPORT bool obs_browser_trace_dump(const char *path)
+{
+	TraceStop();
+	return TraceDump(path);
+}
+
+static void RegisterTraceProcs()
+{
+	proc_handler_t *ph = obs_get_proc_handler();
+
+	proc_handler_add(
+		ph, "void obs_browser_trace_start()",
+		[](void *, calldata_t *) { TraceStart(); }, nullptr);
+	proc_handler_add(
+		ph, "void obs_browser_trace_dump(in string path, out bool success)",
+		[](void *, calldata_t *cd) {
+			const char *path = calldata_string(cd, "path");
+			bool success = path && obs_browser_trace_dump(path);
+			calldata_set_bool(cd, "success", success);
+		},
+		nullptr);
+	proc_handler_add(
+		ph, "void obs_browser_task_stats(out string json)",
+		[](void *, calldata_t *cd) {
+			std::string json = TaskMonitorJson();
+			calldata_set_string(cd, "json", json.c_str());
+		},
+		nullptr);
+
+	/* OBS_BROWSER_TRACE=<file> traces the whole session */
+	const char *path = getenv("OBS_BROWSER_TRACE");
+	if (path && *path)
+		TraceStart();
+}
+
 extern "C" EXPORT void obs_browser_initialize(void)
 {
 	if (!os_atomic_set_bool(&manager_initialized, true)) {
+		TaskMonitorStart();
 #ifdef USE_QT_LOOP
 		BrowserInit();
 #else
@@ -716,6 +1034,7 @@ bool obs_module_load(void)
 #endif
 #endif
 	RegisterBrowserSource();
+	RegisterTraceProcs();
 	obs_frontend_add_event_callback(handle_obs_frontend_event, nullptr);
 
 #ifdef SHARED_TEXTURE_SUPPORT_ENABLED
@@ -736,6 +1055,8 @@ bool obs_module_load(void)
 	return true;
 }
 
+extern void ClearTexturePool();
+
 void obs_module_unload(void)
 {
 #ifdef USE_QT_LOOP
@@ -749,5 +1070,13 @@ void obs_module_unload(void)
 	}
 #endif
 
+	ClearTexturePool();
 	os_event_destroy(cef_started_event);
+
+	TaskMonitorStop();
+	TaskMonitorLog();
+
+	const char *trace_path = getenv("OBS_BROWSER_TRACE");
+	if (trace_path && *trace_path)
+		obs_browser_trace_dump(trace_path);
 }
@@ -19,12 +19,25 @@
 #include "obs-browser-source.hpp"
 #include "browser-client.hpp"
 #include "browser-scheme.hpp"
+#include "browser-trace.hpp"
+#include "browser-process-stats.hpp"
 #include "wide-string.hpp"
 #include "json11/json11.hpp"
 #include <util/threading.h>
+#include <util/platform.h>
+#include <util/config-file.h>
+#include <util/util.hpp>
+#include <graphics/vec4.h>
 #include <QApplication>
 #include <util/dstr.h>
+#include <inttypes.h>
+#include <stdlib.h>
+#include <string.h>
 #include <functional>
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
 #include <thread>
 #include <mutex>
 
@@ -32,6 +45,14 @@
 #include "linux-keyboard-helpers.hpp"
 #endif
 
+#if defined(__APPLE__) && CHROME_VERSION_BUILD > 4430
+#include <IOSurface/IOSurface.h>
+#endif
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
 #ifdef USE_QT_LOOP
 #include <QEventLoop>
 #include <QThread>
@@ -40,11 +61,148 @@
 using namespace std;
 using namespace json11;
 
-extern bool QueueCEFTask(std::function<void()> task);
+#define RENDERER_SAMPLE_INTERVAL_NS 5000000000ULL
+#define RENDERER_RSS_WARN (1024ULL * 1024 * 1024)
+#define RENDERER_CPU_WARN 90.0
+#define RENDERER_CPU_WARN_SAMPLES 3
+
+/* a limit set below what the page needs must not reload it in a loop */
+#define MEMORY_LIMIT_COOLDOWN_NS 60000000000ULL
+/* time a refreshed page gets before its memory is compared */
+#define MEMORY_REFRESH_SETTLE_NS 10000000000ULL
+
+#define PING_INTERVAL_NS 1000000000ULL
+#define PING_TIMEOUT_NS 30000000000ULL
+
+/* OBS_BROWSER_IPC_PROBE=1 pings every renderer once a second to measure
+ * the IPC round trip.  Off by default, it's a message each way per source
+ * per second for numbers only someone chasing latency looks at. */
+static bool IpcProbeEnabled()
+{
+	static bool enabled = [] {
+		const char *env = getenv("OBS_BROWSER_IPC_PROBE");
+		return env && *env && strcmp(env, "0") != 0;
+	}();
+	return enabled;
+}
 
 static mutex browser_list_mutex;
 static BrowserSource *first_browser = nullptr;
 
+/* Budget in MB for the renderers of all browser sources together, from
+ * [Memory] Budget in memory.ini in the module config directory.  Only
+ * called from the graphics thread, the file is re-read when it changes. */
+static uint64_t GetMemoryBudget()
+{
+	static const std::string path = []() {
+		BPtr<char> config_path = obs_module_config_path("memory.ini");
+		return config_path ? std::string(config_path) : std::string();
+	}();
+	static uint64_t budget = 0;
+	static int64_t budget_mtime = 0;
+
+	struct stat st;
+	int64_t mtime = 0;
+	if (!path.empty() && os_stat(path.c_str(), &st) == 0)
+		mtime = GetFileMTime(path, st);
+	if (mtime == budget_mtime)
+		return budget;
+	budget_mtime = mtime;
+
+	uint64_t new_budget = 0;
+	config_t *config = nullptr;
+	if (mtime && config_open(&config, path.c_str(),
+				 CONFIG_OPEN_EXISTING) == CONFIG_SUCCESS) {
+		new_budget = config_get_uint(config, "Memory", "Budget") *
+			     1024 * 1024;
+		config_close(config);
+	}
+
+	if (new_budget != budget)
+		blog(LOG_INFO,
+		     "[obs-browser]: Renderer memory budget: %" PRIu64 " MB%s",
+		     new_budget / (1024 * 1024), new_budget ? "" : " (off)");
+
+	budget = new_budget;
+	return budget;
+}
+
+/* Sources whose browsers live in renderer process |pid| */
+static int CountRendererSources(int pid)
+{
+	lock_guard<mutex> lock(browser_list_mutex);
+	int count = 0;
+
+	for (BrowserSource *bs = first_browser; bs; bs = bs->next) {
+		if (bs->stats.renderer_pid == pid)
+			count++;
+	}
+
+	return count;
+}
+
+/* Called from every source's Tick, which all run on the graphics thread.
+ * When the renderers together exceed the budget, every source in the
+ * largest renderer process is marked.  Sources can share a renderer, and
+ * its memory is only freed once none of them use it anymore. */
+static void CheckMemoryBudget(uint64_t now)
+{
+	static uint64_t check_ts = 0;
+
+	if (now - check_ts < RENDERER_SAMPLE_INTERVAL_NS)
+		return;
+	check_ts = now;
+
+	uint64_t budget = GetMemoryBudget();
+	if (!budget)
+		return;
+
+	lock_guard<mutex> lock(browser_list_mutex);
+	std::unordered_map<int, uint64_t> renderers;
+	uint64_t total = 0;
+	uint64_t largest_rss = 0;
+	int largest = 0;
+
+	for (BrowserSource *bs = first_browser; bs; bs = bs->next) {
+		if (bs->memory_breach)
+			return;
+
+		int pid = bs->stats.renderer_pid;
+		uint64_t rss = bs->stats.renderer_rss;
+		if (!pid || !rss)
+			continue;
+
+		uint64_t &renderer_rss = renderers[pid];
+		renderer_rss = std::max(renderer_rss, rss);
+	}
+
+	for (auto &renderer : renderers) {
+		total += renderer.second;
+		if (renderer.second > largest_rss) {
+			largest_rss = renderer.second;
+			largest = renderer.first;
+		}
+	}
+
+	if (total <= budget || !largest)
+		return;
+
+	int count = 0;
+	for (BrowserSource *bs = first_browser; bs; bs = bs->next) {
+		if (bs->stats.renderer_pid == largest) {
+			bs->memory_breach = true;
+			count++;
+		}
+	}
+
+	blog(LOG_INFO,
+	     "[obs-browser]: Renderers use %" PRIu64 " MB, over the "
+	     "%" PRIu64 " MB budget, the largest (pid %d, %" PRIu64
+	     " MB) is shared by %d source(s)",
+	     total / (1024 * 1024), budget / (1024 * 1024), largest,
+	     largest_rss / (1024 * 1024), count);
+}
+
 static void SendBrowserVisibility(CefRefPtr<CefBrowser> browser, bool isVisible)
 {
 	if (!browser)
@@ -86,6 +244,20 @@ BrowserSource::BrowserSource(obs_data_t *, obs_source_t *source_)
 				   obs_module_text("RefreshNoCache"),
 				   refreshFunction, (void *)this);
 
+	signal_handler_add(obs_source_get_signal_handler(source),
+			   "void renderer_terminated(ptr source, string reason, "
+			   "int count)");
+
+	proc_handler_t *ph = obs_source_get_proc_handler(source);
+	proc_handler_add(
+		ph, "void get_stats(out string json)",
+		[](void *data, calldata_t *cd) {
+			BrowserSource *bs = static_cast<BrowserSource *>(data);
+			std::string json = bs->GetStatsJson();
+			calldata_set_string(cd, "json", json.c_str());
+		},
+		this);
+
 	/* defer update */
 	obs_source_update(source, nullptr);
 
@@ -99,6 +271,8 @@ BrowserSource::BrowserSource(obs_data_t *, obs_source_t *source_)
 
 static void ActuallyCloseBrowser(CefRefPtr<CefBrowser> cefBrowser)
 {
+	TRACE_SCOPE("CloseBrowser");
+
 	CefRefPtr<CefClient> client = cefBrowser->GetHost()->GetClient();
 	BrowserClient *bc = reinterpret_cast<BrowserClient *>(client.get());
 	if (bc) {
@@ -125,6 +299,25 @@ void BrowserSource::Destroy()
 	destroying = true;
 	DestroyTextures();
 
+	if (stats.ipc_rtt.count)
+		blog(LOG_INFO,
+		     "[obs-browser]: '%s' IPC round trip: %" PRIu64 " pings, "
+		     "p50 %.2f ms, p99 %.2f ms, max %.2f ms",
+		     obs_source_get_name(source), (uint64_t)stats.ipc_rtt.count,
+		     (double)stats.ipc_rtt.Percentile(0.5) / 1000.0,
+		     (double)stats.ipc_rtt.Percentile(0.99) / 1000.0,
+		     (double)stats.ipc_rtt.max / 1000.0);
+	if (stats.frame_age.count)
+		blog(LOG_INFO,
+		     "[obs-browser]: '%s' frame age at composite: p50 %.2f ms, "
+		     "p99 %.2f ms, max %.2f ms, %" PRIu64 " frames painted "
+		     "but never drawn",
+		     obs_source_get_name(source),
+		     (double)stats.frame_age.Percentile(0.5) / 1000.0,
+		     (double)stats.frame_age.Percentile(0.99) / 1000.0,
+		     (double)stats.frame_age.max / 1000.0,
+		     (uint64_t)stats.skipped_frames);
+
 	lock_guard<mutex> lock(browser_list_mutex);
 	if (next)
 		next->p_prev_next = p_prev_next;
@@ -133,7 +326,8 @@ void BrowserSource::Destroy()
 	QueueCEFTask([this]() { delete this; });
 }
 
-void BrowserSource::ExecuteOnBrowser(BrowserFunc func, bool async)
+void BrowserSource::ExecuteOnBrowser(BrowserFunc func, bool async,
+				     TaskCategory category)
 {
 	if (!async) {
 #ifdef USE_QT_LOOP
@@ -145,11 +339,13 @@ void BrowserSource::ExecuteOnBrowser(BrowserFunc func, bool async)
 #endif
 		os_event_t *finishedEvent;
 		os_event_init(&finishedEvent, OS_EVENT_TYPE_AUTO);
-		bool success = QueueCEFTask([&]() {
-			if (!!cefBrowser)
-				func(cefBrowser);
-			os_event_signal(finishedEvent);
-		});
+		bool success = QueueCEFTask(
+			[&]() {
+				if (!!cefBrowser)
+					func(cefBrowser);
+				os_event_signal(finishedEvent);
+			},
+			category);
 		if (success) {
 			os_event_wait(finishedEvent);
 		}
@@ -158,9 +354,15 @@ void BrowserSource::ExecuteOnBrowser(BrowserFunc func, bool async)
 		CefRefPtr<CefBrowser> browser = GetBrowser();
 		if (!!browser) {
 #ifdef USE_QT_LOOP
-			QueueBrowserTask(cefBrowser, func);
+			uint64_t queued_ts = os_gettime_ns();
+			QueueBrowserTask(cefBrowser,
+					 [=](CefRefPtr<CefBrowser> b) {
+						 TaskMonitorScope scope(
+							 category, queued_ts);
+						 func(b);
+					 });
 #else
-			QueueCEFTask([=]() { func(browser); });
+			QueueCEFTask([=]() { func(browser); }, category);
 #endif
 		}
 	}
@@ -168,7 +370,9 @@ void BrowserSource::ExecuteOnBrowser(BrowserFunc func, bool async)
 
 bool BrowserSource::CreateBrowser()
 {
-	return QueueCEFTask([this]() {
+	auto create = [this]() {
+		TRACE_SCOPE("CreateBrowser");
+
 #ifdef SHARED_TEXTURE_SUPPORT_ENABLED
 		if (hwaccel) {
 			obs_enter_graphics();
@@ -179,9 +383,18 @@ bool BrowserSource::CreateBrowser()
 		bool hwaccel = false;
 #endif
 
+		std::shared_ptr<AssetBundle> bundle;
+#if CHROME_VERSION_BUILD >= 4638
+		if (!bundle_file.empty())
+			bundle = AssetBundle::Open(bundle_file);
+#endif
+
 		CefRefPtr<BrowserClient> browserClient =
 			new BrowserClient(this, hwaccel && tex_sharing_avail,
-					  reroute_audio, webpage_control_level);
+					  reroute_audio, webpage_control_level,
+					  asset_cache_policy,
+					  CompileRequestRules(request_rules),
+					  bundle);
 
 		CefWindowInfo windowInfo;
 #if CHROME_VERSION_BUILD < 4430
@@ -228,9 +441,16 @@ bool BrowserSource::CreateBrowser()
 			cefBrowserSettings.web_security = STATE_DISABLED;
 		}
 #endif
+		/* the renderer injects the CSS before any page script runs */
+		CefRefPtr<CefDictionaryValue> extraInfo;
+		if (!encoded_css.empty()) {
+			extraInfo = CefDictionaryValue::Create();
+			extraInfo->SetString("css", encoded_css);
+		}
+
 		auto browser = CefBrowserHost::CreateBrowserSync(
 			windowInfo, browserClient, url, cefBrowserSettings,
-			CefRefPtr<CefDictionaryValue>(), nullptr);
+			extraInfo, nullptr);
 
 		SetBrowser(browser);
 
@@ -240,12 +460,15 @@ bool BrowserSource::CreateBrowser()
 			is_showing = true;
 
 		SendBrowserVisibility(cefBrowser, is_showing);
-	});
+		stats.ipc_out++;
+	};
+
+	return QueueCEFTask(create, TaskCategory::Create);
 }
 
 void BrowserSource::DestroyBrowser()
 {
-	ExecuteOnBrowser(ActuallyCloseBrowser, true);
+	ExecuteOnBrowser(ActuallyCloseBrowser, true, TaskCategory::Create);
 	SetBrowser(nullptr);
 }
 #if CHROME_VERSION_BUILD < 4103
@@ -277,7 +500,7 @@ void BrowserSource::SendMouseClick(const struct obs_mouse_event *event,
 			cefBrowser->GetHost()->SendMouseClickEvent(
 				e, buttonType, mouse_up, click_count);
 		},
-		true);
+		true, TaskCategory::Input);
 }
 
 void BrowserSource::SendMouseMove(const struct obs_mouse_event *event,
@@ -296,7 +519,7 @@ void BrowserSource::SendMouseMove(const struct obs_mouse_event *event,
 			cefBrowser->GetHost()->SendMouseMoveEvent(e,
 								  mouse_leave);
 		},
-		true);
+		true, TaskCategory::Input);
 }
 
 void BrowserSource::SendMouseWheel(const struct obs_mouse_event *event,
@@ -315,7 +538,7 @@ void BrowserSource::SendMouseWheel(const struct obs_mouse_event *event,
 			cefBrowser->GetHost()->SendMouseWheelEvent(e, x_delta,
 								   y_delta);
 		},
-		true);
+		true, TaskCategory::Input);
 }
 
 void BrowserSource::SendFocus(bool focus)
@@ -328,7 +551,7 @@ void BrowserSource::SendFocus(bool focus)
 			cefBrowser->GetHost()->SetFocus(focus);
 #endif
 		},
-		true);
+		true, TaskCategory::Input);
 }
 
 void BrowserSource::SendKeyClick(const struct obs_key_event *event, bool key_up)
@@ -382,7 +605,7 @@ void BrowserSource::SendKeyClick(const struct obs_key_event *event, bool key_up)
 				cefBrowser->GetHost()->SendKeyEvent(e);
 			}
 		},
-		true);
+		true, TaskCategory::Input);
 }
 
 void BrowserSource::SetShowing(bool showing)
@@ -399,6 +622,7 @@ void BrowserSource::SetShowing(bool showing)
 			DestroyBrowser();
 		}
 	} else {
+		stats.ipc_out++;
 		ExecuteOnBrowser(
 			[=](CefRefPtr<CefBrowser> cefBrowser) {
 				CefRefPtr<CefProcessMessage> msg =
@@ -409,7 +633,7 @@ void BrowserSource::SetShowing(bool showing)
 				SendBrowserProcessMessage(cefBrowser,
 							  PID_RENDERER, msg);
 			},
-			true);
+			true, TaskCategory::Visibility);
 		Json json = Json::object{{"visible", showing}};
 		DispatchJSEvent("obsSourceVisibleChanged", json.dump(), this);
 #if defined(BROWSER_EXTERNAL_BEGIN_FRAME_ENABLED) && \
@@ -420,11 +644,13 @@ void BrowserSource::SetShowing(bool showing)
 #endif
 
 		SendBrowserVisibility(cefBrowser, showing);
+		stats.ipc_out++;
 	}
 }
 
 void BrowserSource::SetActive(bool active)
 {
+	stats.ipc_out++;
 	ExecuteOnBrowser(
 		[=](CefRefPtr<CefBrowser> cefBrowser) {
 			CefRefPtr<CefProcessMessage> msg =
@@ -434,11 +660,138 @@ void BrowserSource::SetActive(bool active)
 			SendBrowserProcessMessage(cefBrowser, PID_RENDERER,
 						  msg);
 		},
-		true);
+		true, TaskCategory::Visibility);
 	Json json = Json::object{{"active", active}};
 	DispatchJSEvent("obsSourceActiveChanged", json.dump(), this);
 }
 
+void BrowserSource::SendPing()
+{
+	if (!GetBrowser())
+		return;
+
+	int id = ++stats.ping_id;
+	stats.ping_sent_ts = os_gettime_ns();
+	stats.ipc_out++;
+
+	ExecuteOnBrowser(
+		[id](CefRefPtr<CefBrowser> cefBrowser) {
+			CefRefPtr<CefProcessMessage> msg =
+				CefProcessMessage::Create("Ping");
+			msg->GetArgumentList()->SetInt(0, id);
+			SendBrowserProcessMessage(cefBrowser, PID_RENDERER,
+						  msg);
+		},
+		true);
+}
+
+void BrowserSource::SampleRenderer(uint64_t now)
+{
+	int pid = stats.renderer_pid;
+	ProcessSample sample;
+
+	if (!pid || !SampleProcess(pid, sample)) {
+		stats.sample_ts = now;
+		return;
+	}
+
+	if (pid == stats.sample_pid) {
+		stats.renderer_cpu = (double)(sample.cpu_ns -
+					      stats.sample_cpu_ns) *
+				     100.0 / (double)(now - stats.sample_ts);
+	} else {
+		stats.sample_pid = pid;
+		stats.renderer_cpu = 0.0;
+		stats.renderer_rss_peak = 0;
+		stats.rss_warn = RENDERER_RSS_WARN;
+		stats.cpu_high_samples = 0;
+	}
+
+	stats.sample_ts = now;
+	stats.sample_cpu_ns = sample.cpu_ns;
+	stats.renderer_rss = sample.rss;
+	if (sample.rss > stats.renderer_rss_peak)
+		stats.renderer_rss_peak = sample.rss;
+
+	/* a shared renderer's memory is split evenly between its sources */
+	int sharing = std::max(CountRendererSources(pid), 1);
+	uint64_t share = sample.rss / (uint64_t)sharing;
+	stats.renderer_sources = sharing;
+
+	if (memory_refresh_rss &&
+	    now - memory_action_ts >= MEMORY_REFRESH_SETTLE_NS) {
+		if (share >= memory_refresh_rss - memory_refresh_rss / 10) {
+			blog(LOG_INFO,
+			     "[obs-browser]: '%s' refresh didn't lower renderer "
+			     "memory (%" PRIu64 " MB), recreating the browser "
+			     "next time",
+			     obs_source_get_name(source),
+			     share / (1024 * 1024));
+			memory_escalate = true;
+		}
+		memory_refresh_rss = 0;
+	}
+
+	uint64_t limit = (uint64_t)memory_limit * 1024 * 1024;
+	if (limit && share > limit && !memory_breach &&
+	    now - memory_action_ts >= MEMORY_LIMIT_COOLDOWN_NS) {
+		blog(LOG_INFO,
+		     "[obs-browser]: '%s' renderer exceeds its %d MB limit "
+		     "(%" PRIu64 " MB, shared by %d source(s))",
+		     obs_source_get_name(source), memory_limit,
+		     share / (1024 * 1024), sharing);
+		memory_breach = true;
+	}
+
+	/* warn again each time it grows by another half, leaks keep
+	 * showing up in the log without flooding it */
+	if (sample.rss >= stats.rss_warn) {
+		blog(LOG_WARNING,
+		     "[obs-browser]: '%s' renderer (pid %d) is using %" PRIu64
+		     " MB of memory",
+		     obs_source_get_name(source), pid,
+		     sample.rss / (1024 * 1024));
+		stats.rss_warn = sample.rss + sample.rss / 2;
+	}
+
+	if (stats.renderer_cpu < RENDERER_CPU_WARN) {
+		stats.cpu_high_samples = 0;
+	} else if (++stats.cpu_high_samples == RENDERER_CPU_WARN_SAMPLES) {
+		blog(LOG_WARNING,
+		     "[obs-browser]: '%s' renderer (pid %d) has been using "
+		     "%.0f%% CPU for %d seconds",
+		     obs_source_get_name(source), pid,
+		     stats.renderer_cpu.load(),
+		     (int)(RENDERER_CPU_WARN_SAMPLES *
+			   RENDERER_SAMPLE_INTERVAL_NS / 1000000000ULL));
+	}
+}
+
+void BrowserSource::ApplyMemoryLimit()
+{
+	bool recreate = memory_limit_action == MemoryLimitAction::Recreate ||
+			memory_escalate;
+	int sharing = std::max((int)stats.renderer_sources, 1);
+
+	blog(LOG_INFO, "[obs-browser]: '%s' %s to free renderer memory",
+	     obs_source_get_name(source),
+	     recreate ? "recreating browser" : "refreshing");
+
+	memory_breach = false;
+	memory_escalate = false;
+	memory_action_ts = os_gettime_ns();
+	memory_refresh_rss =
+		recreate ? 0 : stats.renderer_rss / (uint64_t)sharing;
+
+	/* stale until the next sample, don't let the budget pick it again */
+	stats.renderer_rss = 0;
+
+	if (recreate)
+		Update();
+	else
+		Refresh();
+}
+
 void BrowserSource::Refresh()
 {
 	ExecuteOnBrowser(
@@ -460,6 +813,467 @@ CefRefPtr<CefBrowser> BrowserSource::GetBrowser()
 	return cefBrowser;
 }
 
+#ifdef SHARED_TEXTURE_SUPPORT_ENABLED
+/* CEF only cycles through a couple of shared handles per browser.  Not
+ * used on Windows, where handles can't be cached. */
+#define MAX_SHARED_TEXTURES 4
+
+static SharedTexture OpenSharedTexture(void *shared_handle)
+{
+	SharedTexture st;
+	st.handle = shared_handle;
+
+#if defined(__APPLE__) && CHROME_VERSION_BUILD > 4183
+	st.texture = gs_texture_create_from_iosurface(
+		(IOSurfaceRef)(uintptr_t)shared_handle);
+#elif defined(_WIN32) && CHROME_VERSION_BUILD > 4183
+	DuplicateHandle(GetCurrentProcess(), (HANDLE)(uintptr_t)shared_handle,
+			GetCurrentProcess(), &st.dup_handle, 0, false,
+			DUPLICATE_SAME_ACCESS);
+
+	st.texture =
+		gs_texture_open_nt_shared((uint32_t)(uintptr_t)shared_handle);
+#else
+	st.texture =
+		gs_texture_open_shared((uint32_t)(uintptr_t)shared_handle);
+#endif
+
+	if (st.texture) {
+		const uint32_t cx = gs_texture_get_width(st.texture);
+		const uint32_t cy = gs_texture_get_height(st.texture);
+		const gs_color_format format =
+			gs_texture_get_color_format(st.texture);
+		const gs_color_format linear_format =
+			gs_generalize_format(format);
+		if (linear_format != format) {
+			st.extra_texture = gs_texture_create(
+				cx, cy, linear_format, 1, nullptr, 0);
+		}
+	}
+
+	return st;
+}
+
+static void CloseSharedTexture(SharedTexture &st)
+{
+	if (st.extra_texture)
+		gs_texture_destroy(st.extra_texture);
+	if (st.texture)
+		gs_texture_destroy(st.texture);
+#ifdef _WIN32
+	if (st.dup_handle)
+		CloseHandle(st.dup_handle);
+#endif
+	st = SharedTexture();
+}
+
+/* Must be called from within the graphics context */
+void BrowserSource::SetSharedTexture(void *shared_handle, uint64_t ts)
+{
+#ifdef _WIN32
+	if (texture)
+		gs_texture_release_sync(texture, 0);
+#endif
+
+	SharedTexture *current = nullptr;
+
+#ifdef _WIN32
+	/* NT handles are only valid during the paint callback, and once closed
+	 * their values get reused for unrelated objects, so a handle value
+	 * can't identify a texture here.  Reopen every new handle. */
+	for (SharedTexture &st : shared_textures)
+		CloseSharedTexture(st);
+	shared_textures.clear();
+#else
+	/* IOSurfaces and shared texture IDs stay valid and unique while CEF
+	 * keeps drawing to them.  The vector is kept in least recently used
+	 * order, the current texture last. */
+	for (auto it = shared_textures.begin(); it != shared_textures.end();
+	     ++it) {
+		if (it->handle == shared_handle) {
+			std::rotate(it, it + 1, shared_textures.end());
+			current = &shared_textures.back();
+			break;
+		}
+	}
+#endif
+
+	if (!current) {
+		SharedTexture st = OpenSharedTexture(shared_handle);
+		if (st.texture) {
+			if (shared_textures.size() >= MAX_SHARED_TEXTURES) {
+				CloseSharedTexture(shared_textures.front());
+				shared_textures.erase(shared_textures.begin());
+			}
+
+			shared_textures.push_back(st);
+			current = &shared_textures.back();
+		}
+	}
+
+	texture = current ? current->texture : nullptr;
+	extra_texture = current ? current->extra_texture : nullptr;
+
+#if defined(_WIN32) && CHROME_VERSION_BUILD > 4183
+	if (texture)
+		gs_texture_acquire_sync(texture, 1, INFINITE);
+#endif
+
+	frame_ts = ts;
+	frame_gen++;
+}
+#endif
+
+/* ========================================================================= */
+/* GS_BGRA textures used by the CPU paint path are pooled between all browser
+ * sources, so that refreshes, recreations and same-sized sources reuse GPU
+ * allocations rather than creating a new texture each time. */
+
+/* Textures kept for reuse, at most 128 MB worth, about four 4K frames */
+#define MAX_POOLED_TEXTURE_BYTES (128ULL * 1024ULL * 1024ULL)
+
+/* Pooled textures of a size no source has shown for this many one second
+ * checks are released */
+#define POOLED_TEXTURE_UNUSED_CHECKS 10
+
+struct PooledTexture {
+	uint32_t cx;
+	uint32_t cy;
+	gs_texture_t *texture;
+	int unused_checks;
+};
+
+static mutex texture_pool_mutex;
+static vector<PooledTexture> texture_pool;
+static uint64_t texture_pool_bytes = 0;
+/* set on module unload, textures released after that aren't pooled */
+static bool texture_pool_closed = false;
+
+static inline uint64_t GetPooledTextureSize(const PooledTexture &pooled)
+{
+	return (uint64_t)pooled.cx * (uint64_t)pooled.cy * 4;
+}
+
+/* Must be called with texture_pool_mutex held, from within the graphics
+ * context */
+static vector<PooledTexture>::iterator
+RemovePooledTexture(vector<PooledTexture>::iterator it)
+{
+	texture_pool_bytes -= GetPooledTextureSize(*it);
+	gs_texture_destroy(it->texture);
+	return texture_pool.erase(it);
+}
+
+/* Must be called from within the graphics context */
+static gs_texture_t *AcquirePooledTexture(uint32_t cx, uint32_t cy)
+{
+	{
+		lock_guard<mutex> lock(texture_pool_mutex);
+		for (auto it = texture_pool.begin(); it != texture_pool.end();
+		     ++it) {
+			if (it->cx == cx && it->cy == cy) {
+				gs_texture_t *texture = it->texture;
+				texture_pool_bytes -= GetPooledTextureSize(*it);
+				texture_pool.erase(it);
+				return texture;
+			}
+		}
+	}
+
+	return gs_texture_create(cx, cy, GS_BGRA, 1, nullptr, GS_DYNAMIC);
+}
+
+/* Must be called from within the graphics context */
+static void ReleasePooledTexture(gs_texture_t *texture)
+{
+	lock_guard<mutex> lock(texture_pool_mutex);
+	PooledTexture pooled = {gs_texture_get_width(texture),
+				gs_texture_get_height(texture), texture, 0};
+	uint64_t size = GetPooledTextureSize(pooled);
+
+	if (texture_pool_closed || size > MAX_POOLED_TEXTURE_BYTES) {
+		gs_texture_destroy(texture);
+		return;
+	}
+
+	/* make room by dropping the largest textures first, they're the most
+	 * memory and the least likely to be shared between sources */
+	while (texture_pool_bytes + size > MAX_POOLED_TEXTURE_BYTES) {
+		auto largest = texture_pool.begin();
+		for (auto it = texture_pool.begin(); it != texture_pool.end();
+		     ++it) {
+			if (GetPooledTextureSize(*it) >
+			    GetPooledTextureSize(*largest))
+				largest = it;
+		}
+		RemovePooledTexture(largest);
+	}
+
+	texture_pool.push_back(pooled);
+	texture_pool_bytes += size;
+}
+
+/* Called from every source's Tick.  Releases pooled textures of sizes that
+ * no source has used for a while, so a source that was removed or resized
+ * doesn't keep its old texture allocated for the rest of the session. */
+static void TrimTexturePool(uint64_t now)
+{
+	static uint64_t check_ts = 0;
+
+	if (now - check_ts < 1000000000ULL)
+		return;
+	check_ts = now;
+
+	vector<pair<uint32_t, uint32_t>> sizes;
+	{
+		lock_guard<mutex> lock(browser_list_mutex);
+		for (BrowserSource *bs = first_browser; bs; bs = bs->next)
+			sizes.emplace_back((uint32_t)bs->width,
+					   (uint32_t)bs->height);
+	}
+
+	obs_enter_graphics();
+	{
+		lock_guard<mutex> lock(texture_pool_mutex);
+		for (auto it = texture_pool.begin(); it != texture_pool.end();) {
+			auto size = make_pair(it->cx, it->cy);
+			if (find(sizes.begin(), sizes.end(), size) !=
+			    sizes.end())
+				it->unused_checks = 0;
+			else
+				it->unused_checks++;
+
+			if (it->unused_checks >= POOLED_TEXTURE_UNUSED_CHECKS)
+				it = RemovePooledTexture(it);
+			else
+				++it;
+		}
+	}
+	obs_leave_graphics();
+}
+
+void ClearTexturePool()
+{
+	obs_enter_graphics();
+	lock_guard<mutex> lock(texture_pool_mutex);
+	for (PooledTexture &pooled : texture_pool)
+		gs_texture_destroy(pooled.texture);
+	texture_pool.clear();
+	texture_pool_bytes = 0;
+	texture_pool_closed = true;
+	obs_leave_graphics();
+}
+
+/* ========================================================================= */
+
+void BrowserSource::DestroyTextures()
+{
+	obs_enter_graphics();
+#ifdef SHARED_TEXTURE_SUPPORT_ENABLED
+	if (!shared_textures.empty()) {
+#ifdef _WIN32
+		if (texture)
+			gs_texture_release_sync(texture, 0);
+#endif
+		for (SharedTexture &st : shared_textures)
+			CloseSharedTexture(st);
+		shared_textures.clear();
+		extra_texture = nullptr;
+		texture = nullptr;
+	}
+#endif
+	if (extra_texture) {
+		gs_texture_destroy(extra_texture);
+		extra_texture = nullptr;
+	}
+	if (texture) {
+		ReleasePooledTexture(texture);
+		texture = nullptr;
+	}
+	if (render_cache) {
+		gs_texrender_destroy(render_cache);
+		render_cache = nullptr;
+	}
+	obs_leave_graphics();
+}
+
+/* Must be called from within the graphics context */
+void BrowserSource::UploadFrame(const void *buffer, int cx, int cy,
+				uint64_t ts)
+{
+	TRACE_SCOPE("UploadFrame");
+
+	if (width != cx || height != cy)
+		DestroyTextures();
+
+	if (!texture && cx && cy) {
+		texture = AcquirePooledTexture(cx, cy);
+		width = cx;
+		height = cy;
+	}
+
+	if (texture) {
+		uint64_t start = os_gettime_ns();
+		gs_texture_set_image(texture, (const uint8_t *)buffer, cx * 4,
+				     false);
+		stats.upload_ns += os_gettime_ns() - start;
+		stats.upload_bytes += (uint64_t)cx * (uint64_t)cy * 4;
+	}
+
+	frame_ts = ts;
+	frame_gen++;
+}
+
+/* Upper bound on the frame memory a single source may hold in its delay
+ * line, a second of 4K video would otherwise take around 2 GB */
+#define MAX_QUEUED_FRAME_BYTES (256ULL * 1024ULL * 1024ULL)
+
+/* Frames kept in addition to the delay itself, so paint/render jitter
+ * doesn't push a frame out of the queue before it's due */
+#define QUEUED_FRAME_SLACK 2
+
+static inline size_t GetFrameSize(int cx, int cy)
+{
+	return (size_t)cx * (size_t)cy * 4;
+}
+
+double GetCanvasFrameRate()
+{
+	struct obs_video_info ovi;
+	if (!obs_get_video_info(&ovi) || !ovi.fps_den)
+		return 30.0;
+	return (double)ovi.fps_num / (double)ovi.fps_den;
+}
+
+int GetMaxSyncOffset(int cx, int cy, double fps)
+{
+	const size_t frame_size = GetFrameSize(cx, cy);
+	if (!frame_size || fps <= 0.0)
+		return 0;
+
+	size_t frames = (size_t)(MAX_QUEUED_FRAME_BYTES / frame_size);
+	if (frames <= QUEUED_FRAME_SLACK)
+		return 0;
+
+	frames -= QUEUED_FRAME_SLACK;
+	return (int)((double)frames * 1000.0 / fps);
+}
+
+/* Called from Update and Tick, so paints never have to ask OBS */
+void BrowserSource::UpdateFrameRate()
+{
+	frame_rate = fps_custom && fps > 0 ? (double)fps
+					   : GetCanvasFrameRate();
+}
+
+int BrowserSource::GetMaxSyncOffset() const
+{
+	return ::GetMaxSyncOffset(width, height, frame_rate);
+}
+
+void BrowserSource::SetSyncAV(bool enabled, int offset)
+{
+	int max_offset = GetMaxSyncOffset();
+	bool changed = enabled != sync_av || offset != sync_av_offset;
+	if (changed && enabled && offset > max_offset)
+		blog(LOG_WARNING,
+		     "[obs-browser]: '%s' video delay of %d ms exceeds the "
+		     "%d ms that fit at %dx%d, clamping",
+		     obs_source_get_name(source), offset, max_offset, width,
+		     height);
+
+	sync_av_offset = offset;
+	if (sync_av.exchange(enabled) && !enabled) {
+		/* the queued frames will never be presented now, ask CEF for
+		 * a fresh paint instead of waiting for the page to change */
+		ClearQueuedFrames();
+		ExecuteOnBrowser(
+			[](CefRefPtr<CefBrowser> cefBrowser) {
+				cefBrowser->GetHost()->Invalidate(PET_VIEW);
+			},
+			true);
+	}
+}
+
+void BrowserSource::QueueFrame(const void *buffer, int cx, int cy,
+			       uint64_t ts)
+{
+	const uint8_t *data = (const uint8_t *)buffer;
+	const size_t size = GetFrameSize(cx, cy);
+	const int offset = std::min((int)sync_av_offset, GetMaxSyncOffset());
+
+	/* enough frames to cover the delay at the browser frame rate */
+	size_t limit = QUEUED_FRAME_SLACK;
+	if (offset > 0)
+		limit += (size_t)std::ceil((double)offset * frame_rate /
+					   1000.0);
+
+	QueuedFrame frame;
+
+	lock_guard<mutex> lock(frame_queue_mutex);
+	/* drop whatever no longer fits, reusing the last buffer dropped */
+	while (frame_queue.size() >= limit) {
+		frame = std::move(frame_queue.front());
+		frame_queue.pop_front();
+	}
+
+	if (frame.data.empty() && !free_frame_buffers.empty()) {
+		frame.data = std::move(free_frame_buffers.back());
+		free_frame_buffers.pop_back();
+	}
+
+	if (free_frame_buffers.size() > limit)
+		free_frame_buffers.resize(limit);
+
+	frame.data.assign(data, data + size);
+	frame.width = cx;
+	frame.height = cy;
+	frame.timestamp = ts;
+	frame_queue.push_back(std::move(frame));
+}
+
+/* Must be called from within the graphics context */
+void BrowserSource::PresentQueuedFrame()
+{
+	/* a positive offset delays video, a negative one delays audio. The
+	 * delay is clamped to what the queue holds so an offset that doesn't
+	 * fit still gives smooth, if shorter, delayed video */
+	const int offset = std::min((int)sync_av_offset, GetMaxSyncOffset());
+	const uint64_t delay = offset > 0 ? (uint64_t)offset * 1000000ULL : 0;
+	const uint64_t now = os_gettime_ns();
+	QueuedFrame frame;
+	bool found = false;
+
+	{
+		lock_guard<mutex> lock(frame_queue_mutex);
+		while (!frame_queue.empty() &&
+		       frame_queue.front().timestamp + delay <= now) {
+			if (found)
+				free_frame_buffers.push_back(
+					std::move(frame.data));
+			frame = std::move(frame_queue.front());
+			frame_queue.pop_front();
+			found = true;
+		}
+	}
+
+	if (!found)
+		return;
+
+	UploadFrame(frame.data.data(), frame.width, frame.height,
+		    frame.timestamp);
+
+	lock_guard<mutex> lock(frame_queue_mutex);
+	free_frame_buffers.push_back(std::move(frame.data));
+}
+
+void BrowserSource::ClearQueuedFrames()
+{
+	lock_guard<mutex> lock(frame_queue_mutex);
+	frame_queue.clear();
+	free_frame_buffers.clear();
+}
+
 #ifdef SHARED_TEXTURE_SUPPORT_ENABLED
 #ifdef BROWSER_EXTERNAL_BEGIN_FRAME_ENABLED
 inline void BrowserSource::SignalBeginFrame()
@@ -477,102 +1291,132 @@ inline void BrowserSource::SignalBeginFrame()
 #endif
 #endif
 
-void BrowserSource::Update(obs_data_t *settings)
+bool BrowserSettings::operator==(const BrowserSettings &other) const
 {
-	if (settings) {
-		bool n_is_local;
-		int n_width;
-		int n_height;
-		bool n_fps_custom;
-		int n_fps;
-		bool n_shutdown;
-		bool n_restart;
-		bool n_reroute;
-		ControlLevel n_webpage_control_level;
-		std::string n_url;
-		std::string n_css;
-
-		n_is_local = obs_data_get_bool(settings, "is_local_file");
-		n_width = (int)obs_data_get_int(settings, "width");
-		n_height = (int)obs_data_get_int(settings, "height");
-		n_fps_custom = obs_data_get_bool(settings, "fps_custom");
-		n_fps = (int)obs_data_get_int(settings, "fps");
-		n_shutdown = obs_data_get_bool(settings, "shutdown");
-		n_restart = obs_data_get_bool(settings, "restart_when_active");
-		n_css = obs_data_get_string(settings, "css");
-		n_url = obs_data_get_string(settings,
-					    n_is_local ? "local_file" : "url");
-		n_reroute = obs_data_get_bool(settings, "reroute_audio");
-		n_webpage_control_level = static_cast<ControlLevel>(
-			obs_data_get_int(settings, "webpage_control_level"));
-
-		if (n_is_local && !n_url.empty()) {
-			n_url = CefURIEncode(n_url, false);
+	/* cheap fields first, the strings can be long */
+	return is_local == other.is_local && width == other.width &&
+	       height == other.height && fps_custom == other.fps_custom &&
+	       fps == other.fps &&
+	       shutdown_on_invisible == other.shutdown_on_invisible &&
+	       restart == other.restart &&
+	       reroute_audio == other.reroute_audio &&
+	       webpage_control_level == other.webpage_control_level &&
+	       asset_cache_policy == other.asset_cache_policy &&
+	       url == other.url && bundle_file == other.bundle_file &&
+	       request_rules == other.request_rules && css == other.css;
+}
 
-#ifdef _WIN32
-			size_t slash = n_url.find("%2F");
-			size_t colon = n_url.find("%3A");
+static BrowserSettings ReadSettings(obs_data_t *settings)
+{
+	BrowserSettings n;
+
+	n.is_local = obs_data_get_bool(settings, "is_local_file");
+	n.width = (int)obs_data_get_int(settings, "width");
+	n.height = (int)obs_data_get_int(settings, "height");
+	n.fps_custom = obs_data_get_bool(settings, "fps_custom");
+	n.fps = (int)obs_data_get_int(settings, "fps");
+	n.shutdown_on_invisible = obs_data_get_bool(settings, "shutdown");
+	n.restart = obs_data_get_bool(settings, "restart_when_active");
+	n.css = obs_data_get_string(settings, "css");
+	n.request_rules = obs_data_get_string(settings, "request_rules");
+	n.bundle_file = obs_data_get_string(settings, "bundle_file");
+	n.url = obs_data_get_string(settings,
+				    n.is_local ? "local_file" : "url");
+	n.reroute_audio = obs_data_get_bool(settings, "reroute_audio");
+	n.webpage_control_level = static_cast<ControlLevel>(
+		obs_data_get_int(settings, "webpage_control_level"));
+	n.asset_cache_policy = static_cast<AssetCachePolicy>(
+		obs_data_get_int(settings, "asset_cache"));
+
+	if (n.is_local && !n.url.empty())
+		n.url = LocalFileURL(n.url);
 
-			if (slash != std::string::npos &&
-			    colon != std::string::npos && colon < slash)
-				n_url.replace(colon, 3, ":");
+#if ENABLE_LOCAL_FILE_URL_SCHEME
+	if (astrcmpi_n(n.url.c_str(), "http://absolute/", 16) == 0) {
+		/* Replace http://absolute/ URLs with file://
+		 * URLs if file:// URLs are enabled */
+		n.url = "file:///" + n.url.substr(16);
+		n.is_local = true;
+	}
 #endif
 
-			while (n_url.find("%5C") != std::string::npos)
-				n_url.replace(n_url.find("%5C"), 3, "/");
-
-			while (n_url.find("%2F") != std::string::npos)
-				n_url.replace(n_url.find("%2F"), 3, "/");
+	return n;
+}
 
-#if !ENABLE_LOCAL_FILE_URL_SCHEME
-			/* http://absolute/ based mapping for older CEF */
-			n_url = "http://absolute/" + n_url;
-#elif defined(_WIN32)
-			/* Widows-style local file URL:
-			 * file:///C:/file/path.webm */
-			n_url = "file:///" + n_url;
-#else
-			/* UNIX-style local file URL:
-			 * file:///home/user/file.webm */
-			n_url = "file://" + n_url;
-#endif
-		}
+BrowserSettings BrowserSource::GetSettings() const
+{
+	BrowserSettings s;
+	s.is_local = is_local;
+	s.width = width;
+	s.height = height;
+	s.fps_custom = fps_custom;
+	s.fps = fps;
+	s.shutdown_on_invisible = shutdown_on_invisible;
+	s.restart = restart;
+	s.reroute_audio = reroute_audio;
+	s.webpage_control_level = webpage_control_level;
+	s.asset_cache_policy = asset_cache_policy;
+	s.url = url;
+	s.css = css;
+	s.request_rules = request_rules;
+	s.bundle_file = bundle_file;
+	return s;
+}
 
-#if ENABLE_LOCAL_FILE_URL_SCHEME
-		if (astrcmpi_n(n_url.c_str(), "http://absolute/", 16) == 0) {
-			/* Replace http://absolute/ URLs with file://
-			 * URLs if file:// URLs are enabled */
-			n_url = "file:///" + n_url.substr(16);
-			n_is_local = true;
-		}
+void BrowserSource::Update(obs_data_t *settings)
+{
+	if (settings) {
+		/* the memory limit applies to the running browser */
+		memory_limit = (int)obs_data_get_int(settings, "memory_limit");
+		memory_limit_action = static_cast<MemoryLimitAction>(
+			obs_data_get_int(settings, "memory_limit_action"));
+		memory_limit_inactive =
+			obs_data_get_bool(settings, "memory_limit_inactive");
+#ifndef __linux__
+		/* renderer memory is only sampled on Linux, where the
+		 * properties are shown */
+		if (memory_limit)
+			blog(LOG_INFO,
+			     "[obs-browser]: '%s' memory limit ignored, only "
+			     "supported on Linux",
+			     obs_source_get_name(source));
 #endif
 
-		if (n_is_local == is_local && n_width == width &&
-		    n_height == height && n_fps_custom == fps_custom &&
-		    n_fps == fps && n_shutdown == shutdown_on_invisible &&
-		    n_restart == restart && n_css == css && n_url == url &&
-		    n_reroute == reroute_audio &&
-		    n_webpage_control_level == webpage_control_level) {
+		BrowserSettings n = ReadSettings(settings);
+		if (n == GetSettings()) {
+			SetSyncAV(obs_data_get_bool(settings, "sync_av"),
+				  (int)obs_data_get_int(settings,
+							"sync_av_offset"));
 			return;
 		}
 
-		is_local = n_is_local;
-		width = n_width;
-		height = n_height;
-		fps = n_fps;
-		fps_custom = n_fps_custom;
-		shutdown_on_invisible = n_shutdown;
-		reroute_audio = n_reroute;
-		webpage_control_level = n_webpage_control_level;
-		restart = n_restart;
-		css = n_css;
-		url = n_url;
+		is_local = n.is_local;
+		width = n.width;
+		height = n.height;
+		fps = n.fps;
+		fps_custom = n.fps_custom;
+		shutdown_on_invisible = n.shutdown_on_invisible;
+		reroute_audio = n.reroute_audio;
+		webpage_control_level = n.webpage_control_level;
+		asset_cache_policy = n.asset_cache_policy;
+		restart = n.restart;
+		css = std::move(n.css);
+		encoded_css = CefURIEncode(css, false).ToString();
+		request_rules = std::move(n.request_rules);
+		bundle_file = std::move(n.bundle_file);
+		url = std::move(n.url);
+
+		/* after the size and frame rate, which bound the delay */
+		UpdateFrameRate();
+		SetSyncAV(obs_data_get_bool(settings, "sync_av"),
+			  (int)obs_data_get_int(settings, "sync_av_offset"));
 
 		obs_source_set_audio_active(source, reroute_audio);
 	}
 
 	DestroyBrowser();
 	DestroyTextures();
+	ClearQueuedFrames();
 #if CHROME_VERSION_BUILD < 4103
 	ClearAudioStreams();
 #endif
@@ -586,6 +1430,47 @@ void BrowserSource::Tick()
 {
 	if (create_browser && CreateBrowser())
 		create_browser = false;
+
+	UpdateFrameRate();
+
+	/* only pay for the render cache when the source was actually drawn
+	 * more than once last frame (multiview, projectors, studio mode) */
+	use_render_cache = render_count > 1;
+	render_count = 0;
+
+	uint64_t now = os_gettime_ns();
+	if (now - stats.rate_ts >= 1000000000ULL) {
+		uint64_t paints = stats.paints;
+		if (stats.rate_ts)
+			stats.paint_rate = (double)(paints - stats.rate_paints) *
+					   1000000000.0 /
+					   (double)(now - stats.rate_ts);
+		stats.rate_ts = now;
+		stats.rate_paints = paints;
+	}
+
+	/* a pong that never comes (renderer gone) only blocks the probe for
+	 * PING_TIMEOUT_NS */
+	uint64_t ping_sent = stats.ping_sent_ts;
+	if (ping_sent && now - ping_sent >= PING_TIMEOUT_NS)
+		stats.ping_sent_ts.compare_exchange_strong(ping_sent, 0);
+
+	if (IpcProbeEnabled() && now - stats.ping_ts >= PING_INTERVAL_NS &&
+	    !stats.ping_sent_ts) {
+		stats.ping_ts = now;
+		SendPing();
+	}
+
+	if (now - stats.sample_ts >= RENDERER_SAMPLE_INTERVAL_NS)
+		SampleRenderer(now);
+
+	CheckMemoryBudget(now);
+	TrimTexturePool(now);
+
+	if (memory_breach &&
+	    (!memory_limit_inactive || !obs_source_active(source)))
+		ApplyMemoryLimit();
+
 #if defined(SHARED_TEXTURE_SUPPORT_ENABLED)
 #if defined(BROWSER_EXTERNAL_BEGIN_FRAME_ENABLED)
 	if (!fps_custom)
@@ -608,13 +1493,87 @@ void BrowserSource::Tick()
 
 extern void ProcessCef();
 
+static void DrawBrowserTexture(gs_effect_t *effect, gs_texture_t *tex,
+			       bool linear_sample, uint32_t flip_flag)
+{
+	gs_eparam_t *const image = gs_effect_get_param_by_name(effect, "image");
+
+	const char *tech;
+	if (linear_sample) {
+		gs_effect_set_texture_srgb(image, tex);
+		tech = "Draw";
+	} else {
+		gs_effect_set_texture(image, tex);
+		tech = "DrawSrgbDecompress";
+	}
+
+	while (gs_effect_loop(effect, tech))
+		gs_draw_sprite(tex, flip_flag, 0, 0);
+}
+
+/* Resolves the current frame (flip, sRGB decompression) into render_cache
+ * once, so that repeat renders within the same frame are a plain draw. */
+void BrowserSource::UpdateRenderCache(gs_effect_t *effect, uint32_t flip_flag)
+{
+	if (!render_cache)
+		render_cache = gs_texrender_create(GS_RGBA, GS_ZS_NONE);
+
+	const uint32_t cx = gs_texture_get_width(texture);
+	const uint32_t cy = gs_texture_get_height(texture);
+
+	gs_texrender_reset(render_cache);
+	if (!gs_texrender_begin(render_cache, cx, cy))
+		return;
+
+	struct vec4 clear_color;
+	vec4_zero(&clear_color);
+	gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+	gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+	const bool previous = gs_framebuffer_srgb_enabled();
+	gs_enable_framebuffer_srgb(true);
+
+	gs_blend_state_push();
+	gs_enable_blending(false);
+
+	/* texcoords are always centered when drawing 1:1 into the cache */
+	DrawBrowserTexture(effect, texture, extra_texture == nullptr,
+			   flip_flag);
+
+	gs_blend_state_pop();
+
+	gs_enable_framebuffer_srgb(previous);
+
+	gs_texrender_end(render_cache);
+	render_cache_gen = frame_gen;
+}
+
 void BrowserSource::Render()
 {
+	TraceThreadName("OBS graphics");
+	TRACE_SCOPE("Render");
+
 	bool flip = false;
 #ifdef SHARED_TEXTURE_SUPPORT_ENABLED
 	flip = hwaccel;
 #endif
 
+	if (sync_av)
+		PresentQueuedFrame();
+
+	render_count++;
+
+	/* frames CEF painted that were replaced before ever being drawn */
+	uint64_t gen = frame_gen;
+	if (stats.rendered_gen != gen) {
+		if (stats.rendered_gen && gen - stats.rendered_gen > 1)
+			stats.skipped_frames += gen - stats.rendered_gen - 1;
+		stats.rendered_gen = gen;
+	}
+
+	if (render_count == 1 && texture && frame_ts)
+		stats.frame_age.Add((os_gettime_ns() - frame_ts) / 1000);
+
 	if (texture) {
 #ifdef __APPLE__
 		gs_effect_t *effect =
@@ -623,12 +1582,26 @@ void BrowserSource::Render()
 #else
 		gs_effect_t *effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
 #endif
+		const uint32_t flip_flag = flip ? GS_FLIP_V : 0;
 
 		bool linear_sample = extra_texture == NULL;
 		gs_texture_t *draw_texture = texture;
-		if (!linear_sample &&
-		    !obs_source_get_texcoords_centered(source)) {
-			gs_copy_texture(extra_texture, texture);
+
+		if (use_render_cache) {
+			if (!render_cache || render_cache_gen != frame_gen)
+				UpdateRenderCache(effect, flip_flag);
+
+			effect = obs_get_base_effect(OBS_EFFECT_DEFAULT);
+			draw_texture = gs_texrender_get_texture(render_cache);
+			linear_sample = true;
+		} else if (!linear_sample &&
+			   !obs_source_get_texcoords_centered(source)) {
+			/* only copy once per new frame, the source may be
+			 * rendered several times per tick (projectors etc) */
+			if (extra_texture_gen != frame_gen) {
+				gs_copy_texture(extra_texture, texture);
+				extra_texture_gen = frame_gen;
+			}
 			draw_texture = extra_texture;
 
 			linear_sample = true;
@@ -640,21 +1613,8 @@ void BrowserSource::Render()
 		gs_blend_state_push();
 		gs_blend_function(GS_BLEND_ONE, GS_BLEND_INVSRCALPHA);
 
-		gs_eparam_t *const image =
-			gs_effect_get_param_by_name(effect, "image");
-
-		const char *tech;
-		if (linear_sample) {
-			gs_effect_set_texture_srgb(image, draw_texture);
-			tech = "Draw";
-		} else {
-			gs_effect_set_texture(image, draw_texture);
-			tech = "DrawSrgbDecompress";
-		}
-
-		const uint32_t flip_flag = flip ? GS_FLIP_V : 0;
-		while (gs_effect_loop(effect, tech))
-			gs_draw_sprite(draw_texture, flip_flag, 0, 0);
+		DrawBrowserTexture(effect, draw_texture, linear_sample,
+				   use_render_cache ? 0 : flip_flag);
 
 		gs_blend_state_pop();
 
@@ -669,13 +1629,39 @@ void BrowserSource::Render()
 #endif
 }
 
+std::string BrowserSource::GetStatsJson()
+{
+	Json json = Json::object{
+		{"paint_rate", stats.paint_rate.load()},
+		{"paints", (double)stats.paints},
+		{"skipped_frames", (double)stats.skipped_frames},
+		{"upload_bytes", (double)stats.upload_bytes},
+		{"upload_ms", (double)stats.upload_ns / 1000000.0},
+		{"graphics_wait_ms", (double)stats.graphics_wait_ns / 1000000.0},
+		{"ipc_in", (double)stats.ipc_in},
+		{"ipc_out", (double)stats.ipc_out},
+		{"audio_packets", (double)stats.audio_packets},
+		{"audio_underruns", (double)stats.audio_underruns},
+		{"ipc_rtt", stats.ipc_rtt.ToJson()},
+		{"frame_age", stats.frame_age.ToJson()},
+		{"renderer_pid", stats.renderer_pid.load()},
+		{"renderer_sources", (int)stats.renderer_sources},
+		{"renderer_rss", (double)stats.renderer_rss},
+		{"renderer_rss_peak", (double)stats.renderer_rss_peak},
+		{"renderer_cpu", stats.renderer_cpu.load()},
+		{"renderer_crashes", (double)stats.renderer_crashes},
+	};
+	return json.dump();
+}
+
 static void ExecuteOnBrowser(BrowserFunc func, BrowserSource *bs)
 {
 	lock_guard<mutex> lock(browser_list_mutex);
 
 	if (bs) {
 		BrowserSource *bsw = reinterpret_cast<BrowserSource *>(bs);
-		bsw->ExecuteOnBrowser(func, true);
+		bsw->ExecuteOnBrowser(func, true, TaskCategory::JSEvent);
+		bsw->stats.ipc_out++;
 	}
 }
 
@@ -686,7 +1672,8 @@ static void ExecuteOnAllBrowsers(BrowserFunc func)
 	BrowserSource *bs = first_browser;
 	while (bs) {
 		BrowserSource *bsw = reinterpret_cast<BrowserSource *>(bs);
-		bsw->ExecuteOnBrowser(func, true);
+		bsw->ExecuteOnBrowser(func, true, TaskCategory::JSEvent);
+		bsw->stats.ipc_out++;
 		bs = bs->next;
 	}
 }
@@ -694,13 +1681,18 @@ static void ExecuteOnAllBrowsers(BrowserFunc func)
 void DispatchJSEvent(std::string eventName, std::string jsonString,
 		     BrowserSource *browser)
 {
-	const auto jsEvent = [=](CefRefPtr<CefBrowser> cefBrowser) {
+	/* converted once and shared by every queued task instead of being
+	 * copied into each of them */
+	auto name = std::make_shared<const CefString>(eventName);
+	auto json = std::make_shared<const CefString>(jsonString);
+
+	const auto jsEvent = [name, json](CefRefPtr<CefBrowser> cefBrowser) {
 		CefRefPtr<CefProcessMessage> msg =
 			CefProcessMessage::Create("DispatchJSEvent");
 		CefRefPtr<CefListValue> args = msg->GetArgumentList();
 
-		args->SetString(0, eventName);
-		args->SetString(1, jsonString);
+		args->SetString(0, *name);
+		args->SetString(1, *json);
 		SendBrowserProcessMessage(cefBrowser, PID_RENDERER, msg);
 	};
 
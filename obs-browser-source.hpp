@@ -23,10 +23,14 @@
 #include "cef-headers.hpp"
 #include "browser-config.h"
 #include "browser-app.hpp"
+#include "browser-task-monitor.hpp"
+#include "browser-histogram.hpp"
 #include <atomic>
 #include <functional>
 #include <string>
 #include <mutex>
+#include <deque>
+#include <vector>
 
 #if CHROME_VERSION_BUILD < 4103
 #include <obs.hpp>
@@ -51,8 +55,111 @@ enum class ControlLevel : int {
 };
 inline constexpr ControlLevel DEFAULT_CONTROL_LEVEL = ControlLevel::ReadObs;
 
+enum class AssetCachePolicy : int {
+	Disabled,
+	Immutable,
+	ImmutableAndHashed,
+};
+inline constexpr AssetCachePolicy DEFAULT_ASSET_CACHE_POLICY =
+	AssetCachePolicy::Disabled;
+
+enum class MemoryLimitAction : int {
+	Refresh,
+	Recreate,
+};
+
 extern bool hwaccel;
 
+extern double GetCanvasFrameRate();
+/* Longest video delay in milliseconds the A/V sync delay line can hold for
+ * cx x cy frames at fps */
+extern int GetMaxSyncOffset(int cx, int cy, double fps);
+
+#ifdef SHARED_TEXTURE_SUPPORT_ENABLED
+struct SharedTexture {
+	void *handle = nullptr;
+	gs_texture_t *texture = nullptr;
+	gs_texture_t *extra_texture = nullptr;
+#ifdef _WIN32
+	void *dup_handle = nullptr;
+#endif
+};
+#endif
+
+struct QueuedFrame {
+	std::vector<uint8_t> data;
+	int width = 0;
+	int height = 0;
+	uint64_t timestamp = 0;
+};
+
+/* Everything Update reads from the source settings, a change to any of
+ * these recreates the browser */
+struct BrowserSettings {
+	bool is_local = false;
+	int width = 0;
+	int height = 0;
+	bool fps_custom = false;
+	int fps = 0;
+	bool shutdown_on_invisible = false;
+	bool restart = false;
+	bool reroute_audio = true;
+	ControlLevel webpage_control_level = DEFAULT_CONTROL_LEVEL;
+	AssetCachePolicy asset_cache_policy = DEFAULT_ASSET_CACHE_POLICY;
+	std::string url;
+	std::string css;
+	std::string request_rules;
+	std::string bundle_file;
+
+	bool operator==(const BrowserSettings &other) const;
+	inline bool operator!=(const BrowserSettings &other) const
+	{
+		return !(*this == other);
+	}
+};
+
+/* Performance counters, bumped from the CEF, graphics and audio threads */
+struct BrowserStats {
+	std::atomic<uint64_t> paints{0};
+	std::atomic<uint64_t> skipped_frames{0};
+	std::atomic<uint64_t> upload_bytes{0};
+	std::atomic<uint64_t> upload_ns{0};
+	std::atomic<uint64_t> graphics_wait_ns{0};
+	std::atomic<uint64_t> ipc_in{0};
+	std::atomic<uint64_t> ipc_out{0};
+	std::atomic<uint64_t> audio_packets{0};
+	std::atomic<uint64_t> audio_underruns{0};
+
+	/* updated once a second from Tick */
+	std::atomic<double> paint_rate{0.0};
+	uint64_t rate_ts = 0;
+	uint64_t rate_paints = 0;
+	uint64_t rendered_gen = 0;
+
+	/* age of the frame drawn by the first Render of each OBS frame */
+	LatencyHistogram frame_age;
+
+	/* renderer process, reported by the renderer and sampled from Tick.
+	 * Sources showing the same site can share a process. */
+	std::atomic<int> renderer_pid{0};
+	std::atomic<int> renderer_sources{0}; /* sources sharing it */
+	std::atomic<uint64_t> renderer_rss{0};
+	std::atomic<uint64_t> renderer_rss_peak{0};
+	std::atomic<double> renderer_cpu{0.0}; /* % of one core */
+	uint64_t sample_ts = 0;
+	uint64_t sample_cpu_ns = 0;
+	int sample_pid = 0;
+	uint64_t rss_warn = 0;
+	int cpu_high_samples = 0;
+	std::atomic<uint64_t> renderer_crashes{0};
+
+	/* round trips of the Ping/Pong probe sent from Tick, one at a time */
+	LatencyHistogram ipc_rtt;
+	std::atomic<int> ping_id{0};
+	std::atomic<uint64_t> ping_sent_ts{0};
+	uint64_t ping_ts = 0;
+};
+
 struct BrowserSource {
 	BrowserSource **p_prev_next = nullptr;
 	BrowserSource *next = nullptr;
@@ -66,6 +173,7 @@ struct BrowserSource {
 
 	std::string url;
 	std::string css;
+	std::string encoded_css;
 	gs_texture_t *texture = nullptr;
 	gs_texture_t *extra_texture = nullptr;
 	int width = 0;
@@ -80,31 +188,81 @@ struct BrowserSource {
 	bool reroute_audio = true;
 	std::atomic<bool> destroying = false;
 	ControlLevel webpage_control_level = DEFAULT_CONTROL_LEVEL;
+	AssetCachePolicy asset_cache_policy = DEFAULT_ASSET_CACHE_POLICY;
+	std::string request_rules;
+	std::string bundle_file;
+
+	/* renderer memory limit, 0 MB disables it.  A breach of the limit or
+	 * of the global budget is acted on in Tick once the source is in its
+	 * safe window. */
+	int memory_limit = 0;
+	MemoryLimitAction memory_limit_action = MemoryLimitAction::Refresh;
+	bool memory_limit_inactive = true;
+	std::atomic<bool> memory_breach = false;
+	uint64_t memory_action_ts = 0;
+	/* a refresh keeps the renderer process, so it doesn't necessarily
+	 * free anything.  This source's share of the renderer before the last
+	 * refresh, and whether the next action recreates instead. */
+	uint64_t memory_refresh_rss = 0;
+	bool memory_escalate = false;
 #if defined(BROWSER_EXTERNAL_BEGIN_FRAME_ENABLED) && \
 	defined(SHARED_TEXTURE_SUPPORT_ENABLED)
 	bool reset_frame = false;
 #endif
 	bool is_showing = false;
 
-	inline void DestroyTextures()
-	{
-		obs_enter_graphics();
-		if (extra_texture) {
-			gs_texture_destroy(extra_texture);
-			extra_texture = nullptr;
-		}
-		if (texture) {
-			gs_texture_destroy(texture);
-			texture = nullptr;
-		}
-		obs_leave_graphics();
-	}
+	/* audio/video sync: frames painted by CEF are timestamped and, when
+	 * sync_av is enabled, held in a delay line until they're due. Both
+	 * settings apply to the running browser */
+	std::atomic<bool> sync_av{false};
+	std::atomic<int> sync_av_offset{0};
+	uint64_t last_frame_ts = 0;
+	std::atomic<double> frame_rate{30.0};
+	std::mutex frame_queue_mutex;
+	std::deque<QueuedFrame> frame_queue;
+	std::vector<std::vector<uint8_t>> free_frame_buffers;
+
+#ifdef SHARED_TEXTURE_SUPPORT_ENABLED
+	/* opened shared textures, kept alive while CEF cycles through its
+	 * handles (only the current one on Windows); texture/extra_texture
+	 * point into this cache when in use */
+	std::vector<SharedTexture> shared_textures;
+#endif
+
+	/* bumped for every new frame from CEF so work derived from the
+	 * current texture only has to be done once per frame */
+	std::atomic<uint64_t> frame_gen{0};
+	std::atomic<uint64_t> frame_ts{0}; /* when CEF painted the frame */
+	uint64_t extra_texture_gen = 0;
+
+	gs_texrender_t *render_cache = nullptr;
+	uint64_t render_cache_gen = 0;
+	int render_count = 0;
+	bool use_render_cache = false;
+
+	BrowserStats stats;
+
+	void DestroyTextures();
 
 	/* ---------------------------- */
 
 	bool CreateBrowser();
 	void DestroyBrowser();
-	void ExecuteOnBrowser(BrowserFunc func, bool async = false);
+	void ExecuteOnBrowser(BrowserFunc func, bool async = false,
+			      TaskCategory category = TaskCategory::Other);
+
+	/* ---------------------------- */
+
+#ifdef SHARED_TEXTURE_SUPPORT_ENABLED
+	void SetSharedTexture(void *shared_handle, uint64_t ts);
+#endif
+	void UploadFrame(const void *buffer, int cx, int cy, uint64_t ts);
+	void QueueFrame(const void *buffer, int cx, int cy, uint64_t ts);
+	void PresentQueuedFrame();
+	void ClearQueuedFrames();
+	void SetSyncAV(bool enabled, int offset);
+	void UpdateFrameRate();
+	int GetMaxSyncOffset() const;
 
 	/* ---------------------------- */
 
@@ -113,9 +271,11 @@ struct BrowserSource {
 
 	void Destroy();
 
+	BrowserSettings GetSettings() const;
 	void Update(obs_data_t *settings = nullptr);
 	void Tick();
 	void Render();
+	void UpdateRenderCache(gs_effect_t *effect, uint32_t flip_flag);
 #if CHROME_VERSION_BUILD < 4103
 	void ClearAudioStreams();
 	void EnumAudioStreams(obs_source_enum_proc_t cb, void *param);
@@ -137,6 +297,11 @@ struct BrowserSource {
 	void SetActive(bool active);
 	void Refresh();
 
+	void SendPing();
+	void SampleRenderer(uint64_t now);
+	void ApplyMemoryLimit();
+	std::string GetStatsJson();
+
 #if defined(BROWSER_EXTERNAL_BEGIN_FRAME_ENABLED) && \
 	defined(SHARED_TEXTURE_SUPPORT_ENABLED)
 	inline void SignalBeginFrame();
@@ -1,5 +1,6 @@
 #include "browser-panel-client.hpp"
-#include <util/dstr.h>
+#include <util/platform.h>
+#include <util/util.hpp>
 
 #include <QUrl>
 #include <QDesktopServices>
@@ -19,6 +20,87 @@
 #include <X11/Xlib.h>
 #endif
 
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+/* error.html is localized once and split around its %%ERROR_CODE%% and
+ * %%ERROR_URL%% placeholders, with the static parts already URI-encoded,
+ * so a load error only has to encode the two values and concatenate. */
+enum class ErrorPageField {
+	Code,
+	URL,
+};
+
+static std::vector<std::string> errorPageParts;
+static std::vector<ErrorPageField> errorPageFields;
+static size_t errorPageSize = 0;
+static std::once_flag errorPageOnce;
+
+static void ReplaceAll(std::string &str, const std::string &from,
+		       const std::string &to)
+{
+	size_t pos = 0;
+	while ((pos = str.find(from, pos)) != std::string::npos) {
+		str.replace(pos, from.size(), to);
+		pos += to.size();
+	}
+}
+
+static std::string EncodeErrorPageText(std::string text)
+{
+	ReplaceAll(text, "&", "&amp;");
+	ReplaceAll(text, "<", "&lt;");
+	ReplaceAll(text, ">", "&gt;");
+	ReplaceAll(text, "\"", "&quot;");
+	return CefURIEncode(text, false).ToString();
+}
+
+void LoadErrorPageTemplate(void)
+{
+	std::call_once(errorPageOnce, []() {
+		BPtr<char> path = obs_module_file("error.html");
+		BPtr<char> file = path ? os_quick_read_utf8_file(path)
+				       : nullptr;
+		if (!file)
+			return;
+
+		std::string html = file.Get();
+		ReplaceAll(html, "Error.Title", obs_module_text("Error.Title"));
+		ReplaceAll(html, "Error.Description",
+			   obs_module_text("Error.Description"));
+		ReplaceAll(html, "Error.Retry", obs_module_text("Error.Retry"));
+
+		const std::string code = "%%ERROR_CODE%%";
+		const std::string url = "%%ERROR_URL%%";
+		size_t start = 0;
+
+		for (;;) {
+			size_t code_pos = html.find(code, start);
+			size_t url_pos = html.find(url, start);
+			size_t pos = std::min(code_pos, url_pos);
+			if (pos == std::string::npos)
+				break;
+
+			bool is_code = pos == code_pos;
+			std::string part = html.substr(start, pos - start);
+
+			errorPageParts.push_back(
+				CefURIEncode(part, false).ToString());
+			errorPageFields.push_back(
+				is_code ? ErrorPageField::Code
+					: ErrorPageField::URL);
+			start = pos + (is_code ? code.size() : url.size());
+		}
+
+		errorPageParts.push_back(
+			CefURIEncode(html.substr(start), false).ToString());
+
+		for (const std::string &part : errorPageParts)
+			errorPageSize += part.size();
+	});
+}
+
 /* CefClient */
 CefRefPtr<CefLoadHandler> QCefBrowserClient::GetLoadHandler()
 {
@@ -131,36 +213,32 @@ void QCefBrowserClient::OnLoadError(CefRefPtr<CefBrowser> browser,
 	if (errorCode == ERR_ABORTED)
 		return;
 
-	struct dstr html;
-	char *path = obs_module_file("error.html");
-	char *errorPage = os_quick_read_utf8_file(path);
-
-	dstr_init_copy(&html, errorPage);
-
-	dstr_replace(&html, "%%ERROR_URL%%", failedUrl.ToString().c_str());
+	LoadErrorPageTemplate();
+	if (errorPageParts.empty())
+		return;
 
-	dstr_replace(&html, "Error.Title", obs_module_text("Error.Title"));
-	dstr_replace(&html, "Error.Description",
-		     obs_module_text("Error.Description"));
-	dstr_replace(&html, "Error.Retry", obs_module_text("Error.Retry"));
 	const char *translError;
 	std::string errorKey = "ErrorCode." + errorText.ToString();
-	if (obs_module_get_string(errorKey.c_str(),
-				  (const char **)&translError)) {
-		dstr_replace(&html, "%%ERROR_CODE%%", translError);
-	} else {
-		dstr_replace(&html, "%%ERROR_CODE%%",
-			     errorText.ToString().c_str());
+	if (!obs_module_get_string(errorKey.c_str(),
+				   (const char **)&translError))
+		translError = nullptr;
+
+	std::string code = EncodeErrorPageText(
+		translError ? translError : errorText.ToString());
+	std::string url = EncodeErrorPageText(failedUrl.ToString());
+
+	std::string page = "data:text/html;charset=utf-8,";
+	page.reserve(page.size() + errorPageSize +
+		     errorPageFields.size() *
+			     std::max(code.size(), url.size()));
+
+	for (size_t i = 0; i < errorPageFields.size(); i++) {
+		page += errorPageParts[i];
+		page += errorPageFields[i] == ErrorPageField::Code ? code : url;
 	}
+	page += errorPageParts.back();
 
-	frame->LoadURL(
-		"data:text/html;base64," +
-		CefURIEncode(CefBase64Encode(html.array, html.len), false)
-			.ToString());
-
-	dstr_free(&html);
-	bfree(path);
-	bfree(errorPage);
+	frame->LoadURL(page);
 }
 
 /* CefLifeSpanHandler */
@@ -5,6 +5,9 @@
 
 #include <string>
 
+/* Loads and localizes error.html, only does work the first time */
+extern void LoadErrorPageTemplate(void);
+
 class QCefBrowserClient : public CefClient,
 			  public CefDisplayHandler,
 			  public CefRequestHandler,
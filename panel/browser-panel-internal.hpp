@@ -1,6 +1,5 @@
 #pragma once
 
-#include <QTimer>
 #include <QPointer>
 #include "browser-panel.hpp"
 #include "cef-headers.hpp"
@@ -36,15 +35,25 @@ public:
 	std::string url;
 	std::string script;
 	CefRefPtr<CefRequestContext> rqc;
-	QTimer timer;
+	bool initQueued = false;
 #ifndef __APPLE__
 	QPointer<QWindow> window;
 	QPointer<QWidget> container;
 #endif
 	bool allowAllPopups_ = false;
 
+#ifndef __APPLE__
+	/* At most one resize task is queued at a time; it applies whatever
+	 * size is pending when it runs. */
+	std::mutex resizeMutex;
+	QSize pendingSize;
+	bool resizePending = false;
+	QSize appliedSize; /* CEF UI thread only */
+#endif
+
 	virtual void resizeEvent(QResizeEvent *event) override;
 	virtual void showEvent(QShowEvent *event) override;
+	virtual void hideEvent(QHideEvent *event) override;
 	virtual QPaintEngine *paintEngine() const override;
 
 	virtual void setURL(const std::string &url) override;
@@ -54,6 +63,7 @@ public:
 	virtual void reloadPage() override;
 
 	void Resize();
+	void SetBrowserVisible(bool visible);
 
 #ifdef __linux__
 private:
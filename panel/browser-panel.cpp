@@ -2,6 +2,7 @@
 #include "browser-panel-client.hpp"
 #include "cef-headers.hpp"
 #include "browser-app.hpp"
+#include "browser-task-monitor.hpp"
 
 #include <QWindow>
 #include <QApplication>
@@ -24,9 +25,9 @@
 #include <X11/Xlib.h>
 #endif
 
-extern bool QueueCEFTask(std::function<void()> task);
 extern "C" void obs_browser_initialize(void);
 extern os_event_t *cef_started_event;
+extern void OnCEFStarted(std::function<void()> callback);
 
 std::mutex popup_whitelist_mutex;
 std::vector<PopupWhitelistInfo> popup_whitelist;
@@ -334,6 +335,9 @@ void QCefWidgetInternal::Init()
 				windowInfo, browserClient, url,
 				cefBrowserSettings,
 				CefRefPtr<CefDictionaryValue>(), rqc);
+#ifndef __APPLE__
+			appliedSize = size;
+#endif
 
 #ifdef __linux__
 			QueueCEFTask([this]() { unsetToplevelXdndProxy(); });
@@ -341,7 +345,6 @@ void QCefWidgetInternal::Init()
 		});
 
 	if (success) {
-		timer.stop();
 #ifndef __APPLE__
 		if (!container) {
 			container =
@@ -364,9 +367,30 @@ void QCefWidgetInternal::resizeEvent(QResizeEvent *event)
 void QCefWidgetInternal::Resize()
 {
 	QSize size = this->size() * devicePixelRatioF();
+	bool queue;
+
+	{
+		std::lock_guard<std::mutex> lock(resizeMutex);
+		pendingSize = size;
+		queue = !resizePending;
+		resizePending = true;
+	}
+
+	if (container)
+		container->resize(size.width(), size.height());
+	if (!queue)
+		return;
+
+	bool success = QueueCEFTask([this]() {
+		QSize size;
+
+		{
+			std::lock_guard<std::mutex> lock(resizeMutex);
+			size = pendingSize;
+			resizePending = false;
+		}
 
-	bool success = QueueCEFTask([this, size]() {
-		if (!cefBrowser)
+		if (!cefBrowser || size == appliedSize)
 			return;
 
 		CefWindowHandle handle =
@@ -395,26 +419,98 @@ void QCefWidgetInternal::Resize()
 		XConfigureWindow(xDisplay, (Window)handle,
 				 CWX | CWY | CWHeight | CWWidth, &changes);
 #if CHROME_VERSION_BUILD >= 4638
-		XSync(xDisplay, false);
+		/* the request only needs to reach the server, there's no
+		 * reply to wait for */
+		XFlush(xDisplay);
 #endif
 #endif
+		/* only once the native window was actually resized, so an
+		 * early return above leaves the size to the next resize */
+		appliedSize = size;
 	});
 
-	if (success && container)
-		container->resize(size.width(), size.height());
+	if (!success) {
+		std::lock_guard<std::mutex> lock(resizeMutex);
+		resizePending = false;
+	}
 #endif
 }
 
+/* Hiding the native browser window lets Chromium treat the page as hidden
+ * (timers and rAF throttled, no painting) while the dock is closed,
+ * minimized or stacked behind another tab. */
+void QCefWidgetInternal::SetBrowserVisible(bool visible)
+{
+	CefRefPtr<CefBrowser> browser = cefBrowser;
+	if (!browser)
+		return;
+
+	QueueCEFTask([browser, visible]() {
+		CefWindowHandle handle = browser->GetHost()->GetWindowHandle();
+		if (!handle)
+			return;
+
+#ifdef _WIN32
+		ShowWindow((HWND)handle, visible ? SW_SHOWNA : SW_HIDE);
+#elif __APPLE__
+		((void (*)(id, SEL, BOOL))objc_msgSend)(
+			(id)handle, sel_getUid("setHidden:"),
+			visible ? NO : YES);
+#else
+		Display *xDisplay = cef_get_xdisplay();
+		if (!xDisplay)
+			return;
+
+		if (visible)
+			XMapWindow(xDisplay, (Window)handle);
+		else
+			XUnmapWindow(xDisplay, (Window)handle);
+		XFlush(xDisplay);
+#endif
+	});
+}
+
+void QCefWidgetInternal::hideEvent(QHideEvent *event)
+{
+	QWidget::hideEvent(event);
+	SetBrowserVisible(false);
+}
+
 void QCefWidgetInternal::showEvent(QShowEvent *event)
 {
 	QWidget::showEvent(event);
 
-	if (!cefBrowser) {
-		obs_browser_initialize();
-		connect(&timer, SIGNAL(timeout()), this, SLOT(Init()));
-		timer.start(500);
+	if (cefBrowser) {
+		SetBrowserVisible(true);
+		return;
+	}
+	if (initQueued)
+		return;
+
+	obs_browser_initialize();
+
+	if (os_event_try(cef_started_event) == 0) {
 		Init();
+		return;
 	}
+
+	/* every pending dock initializes as soon as the CEF thread is up */
+	QPointer<QCefWidgetInternal> self(this);
+	initQueued = true;
+	OnCEFStarted([self]() {
+		QMetaObject::invokeMethod(
+			QCoreApplication::instance(),
+			[self]() {
+				if (!self)
+					return;
+
+				/* cleared first so a failed Init can be
+				 * retried from the next showEvent */
+				self->initQueued = false;
+				self->Init();
+			},
+			Qt::QueuedConnection);
+	});
 }
 
 QPaintEngine *QCefWidgetInternal::paintEngine() const
@@ -531,6 +627,7 @@ void QCefInternal::add_force_popup_url(const std::string &url, QObject *obj)
 
 extern "C" EXPORT QCef *obs_browser_create_qcef(void)
 {
+	LoadErrorPageTemplate();
 	return new QCefInternal();
 }
 